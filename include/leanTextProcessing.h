@@ -24,6 +24,7 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include <boost/format.hpp>
 #include <string>
+#include <string_view>
 #include <exception>
 #include <assert.h>
 
@@ -49,14 +50,15 @@ namespace LeanTextProcessing {
 	};
 
 	// named text
+	// the text is borrowed: it has to outlive the container and all iterators over it
 	struct TextContainer {
 		std::string name;
-		std::string text;
+		std::string_view text;
 
 		// TODO: change parameter order [3/17/2013 Andreas]
-		TextContainer( const std::string &text, const std::string &name ) 
-			: text( text )
-			, name( name )
+		TextContainer( std::string_view text, const std::string &name ) 
+			: name( name )
+			, text( text )
 		{}
 	};
 
@@ -95,7 +97,7 @@ namespace LeanTextProcessing {
 			if( textContainer.text[ current.index ] == '\r' ) {
 				newLine = true;
 
-				if( textContainer.text[ current.index + 1 ] == '\n' ) {
+				if( current.index + 1 < (int) textContainer.text.size() && textContainer.text[ current.index + 1 ] == '\n' ) {
 					++current.index;
 				}
 			}
@@ -113,7 +115,7 @@ namespace LeanTextProcessing {
 
 			// note: newlines won't have been converted
 			std::string getScopedText() {
-				return iterator.textContainer.text.substr( saved.index, iterator.current.index - saved.index );
+				return std::string( iterator.textContainer.text.substr( saved.index, iterator.current.index - saved.index ) );
 			}
 
 			// accept the parsed text
@@ -225,18 +227,28 @@ namespace LeanTextProcessing {
 
 		TextContext() {}
 
-		TextContext( TextContext &&context ) 
+		TextContext( const TextContext &context ) = default;
+		TextContext & operator = ( const TextContext &context ) = default;
+
+		TextContext( TextContext &&context ) noexcept
 			: name( std::move( context.name ) )
 			, position( std::move( context.position ) )
 			, surroundingText( std::move( context.surroundingText ) ) 
 		{}
 
+		TextContext & operator = ( TextContext &&context ) noexcept {
+			name = std::move( context.name );
+			position = context.position;
+			surroundingText = std::move( context.surroundingText );
+			return *this;
+		}
+
 		TextContext( const TextIterator &iterator, int contextWidth = 30 ) 
 			: name( iterator.textContainer.name )
 			, position( iterator.current )
 			, surroundingText( 
-				iterator.textContainer.text.substr( std::max( 0, position.index - contextWidth ), contextWidth ) 
-					+ "*HERE*" + iterator.textContainer.text.substr( std::max( 0, position.index ), contextWidth )
+				std::string( iterator.textContainer.text.substr( std::max( 0, position.index - contextWidth ), contextWidth ) )
+					+ "*HERE*" + std::string( iterator.textContainer.text.substr( std::max( 0, position.index ), contextWidth ) )
 				) 
 		{}
 	};
@@ -262,7 +274,7 @@ namespace LeanTextProcessing {
 				);
 		}
 
-		virtual const char * what() const {
+		virtual const char * what() const noexcept {
 			return message.c_str();
 		}
 	};
@@ -25,30 +25,106 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "wml_node.h"
 #include "wml_detail_parser.h"
 #include "wml_detail_emitter.h"
+#include "wml_shared_node.h"
+#include "wml_path.h"
 
 namespace wml {
-	inline Node parse( const std::string &content, const std::string &sourceIdentifier = "" ) {
-		return detail::parse( content, sourceIdentifier );
+	// stats (optional) receives the counters of the call (see Stats)
+	// NodeT chooses the storage of the tree (see BasicNode)
+	// content is only read during the call (it isn't copied, so it can be a mapped file)
+	template< typename NodeT = Node >
+	NodeT parse( std::string_view content, const std::string &sourceIdentifier = "", const ParseOptions &options = ParseOptions(), Stats *stats = nullptr ) {
+		return detail::parse< NodeT >( content, sourceIdentifier, options, stats );
 	}
 
-	inline Node parse( std::istream &stream, const std::string &sourceIdentifier = "" ) {
-		std::string content = std::string( std::istreambuf_iterator<char>( stream ), std::istreambuf_iterator<char>() );
-		return detail::parse( content, sourceIdentifier );
+	template< typename NodeT = Node >
+	NodeT parse( std::istream &stream, const std::string &sourceIdentifier = "", const ParseOptions &options = ParseOptions(), Stats *stats = nullptr ) {
+		std::string content;
+		{
+			WML_TRACE_SCOPE( "read", 0 );
+			detail::StatsScope scope( stats, &Stats::readTime );
+			content = std::string( std::istreambuf_iterator<char>( stream ), std::istreambuf_iterator<char>() );
+		}
+		return detail::parse< NodeT >( content, sourceIdentifier, options, stats );
 	}
 
-	inline Node parseFile( const std::string &filename ) {
+	template< typename NodeT = Node >
+	NodeT parseFile( const std::string &filename, const ParseOptions &options = ParseOptions(), Stats *stats = nullptr ) {
 		std::ifstream file( filename, std::ios_base::binary );
 		if( file.is_open() ) {
-			return parse( file );
+			return parse< NodeT >( file, "", options, stats );
 		}
-		return Node();
+		return NodeT();
+	}
+
+	// stats (optional) receives the counters of the call (see Stats)
+	template< typename Traits >
+	std::string emit( const BasicNode< Traits > &node, Stats *stats = nullptr ) {
+		return detail::emit( node, stats );
+	}
+
+	// streaming emission: the text is passed to write in chunks of at most bufferSize bytes
+	// (values that are bigger than the buffer are passed on directly)
+	template< typename Traits >
+	void emit( const BasicNode< Traits > &node, const std::function< void ( const char *data, size_t size ) > &write, size_t bufferSize = 64 * 1024 ) {
+		detail::emit( node, write, bufferSize );
+	}
+
+	template< typename Traits >
+	void emit( const BasicNode< Traits > &node, std::ostream &stream, size_t bufferSize = 64 * 1024 ) {
+		emit( node, [&stream] ( const char *data, size_t size ) { stream.write( data, size ); }, bufferSize );
+	}
+
+	// returns false if writing failed (see errno)
+	template< typename Traits >
+	bool emitToDescriptor( const BasicNode< Traits > &node, int fileDescriptor, size_t bufferSize = 64 * 1024 ) {
+		bool success = true;
+		emit( node, [&] ( const char *data, size_t size ) {
+			success = success && detail::writeToDescriptor( fileDescriptor, data, size );
+		}, bufferSize );
+		return success;
 	}
 
-	inline std::string emit( const Node &node ) {
-		return detail::emit( node );
+	// exact length of emit( node )
+	template< typename Traits >
+	size_t emittedSize( const BasicNode< Traits > &node ) {
+		detail::CountingOutput output;
+		detail::emit( node, output );
+		return output.size;
 	}
 
-	inline void emitFile( const std::string &filename, const Node &node ) {
-		std::ofstream( filename ) << emit( node );
+	// emits into buffer without allocating (no null terminator is added)
+	// returns the length of the text: if it is bigger than capacity, the text didn't fit and
+	// the contents of buffer are undefined
+	template< typename Traits >
+	size_t emitInto( const BasicNode< Traits > &node, char *buffer, size_t capacity ) {
+		detail::FixedOutput output( buffer, capacity );
+		detail::emit( node, output );
+		return output.size;
+	}
+
+	// emits independent parts of the tree concurrently (same result as emit)
+	inline std::string emitParallel( const Node &node, unsigned numThreads = std::thread::hardware_concurrency() ) {
+		return detail::emitParallel( node, numThreads );
+	}
+
+	// writes the parts with writev without joining them, returns false if writing failed (see errno)
+	inline bool emitParallelToDescriptor( const Node &node, int fileDescriptor, unsigned numThreads = std::thread::hardware_concurrency() ) {
+		return detail::emitParallel( node, fileDescriptor, numThreads );
+	}
+
+	// emits a tree that has been parsed from originalSource, but copies the text of all entries that
+	// haven't been modified (see Node::span), so formatting and empty lines are kept
+	// the tree has to be parsed with ParseOptions::trackSourceSpans, otherwise it is emitted anew
+	inline std::string emitPreserving( const Node &root, const std::string &originalSource ) {
+		return detail::emitPreserving( root, originalSource );
+	}
+
+	template< typename Traits >
+	void emitFile( const std::string &filename, const BasicNode< Traits > &node ) {
+		WML_TRACE_SCOPE( "emitFile", 0 );
+
+		std::ofstream file( filename );
+		emit( node, file );
 	}
 }
\ No newline at end of file
@@ -0,0 +1,418 @@
+/*
+Copyright 2013 Andreas Kirsch
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <array>
+#include <tuple>
+#include <vector>
+#include <optional>
+#include <fstream>
+
+#include "wml.h"
+
+namespace wml {
+	// binds WML keys to the fields of a struct, so documents can be parsed straight into C++ objects
+	// without building a Node tree (see parseAs)
+	//
+	// specialize Binding for every struct:
+	//
+	//	struct Vertex { float x, y, z; };
+	//	struct Mesh { std::string name; std::vector< float > weights; std::optional< int > lod; std::vector< Vertex > vertices; };
+	//
+	//	template<>
+	//	struct wml::Binding< Mesh > {
+	//		static constexpr auto fields = std::make_tuple(
+	//			WML_FIELD( Mesh, name ),
+	//			WML_FIELD( Mesh, weights ),
+	//			wml::field( "level-of-detail", &Mesh::lod ),
+	//			WML_FIELD( Mesh, vertices )
+	//		);
+	//	};
+	//
+	// field types:
+	//	T						one value (converted with Converter< T >)
+	//	std::optional< T >		like T, but the key may be missing
+	//	std::vector< T >		all values of all entries with the key (if T is converted with Converter)
+	//							or one element per entry (otherwise)
+	//	struct with a Binding	a map
+	//
+	// all other fields are required, unknown and duplicate keys are errors
+	template< typename T >
+	struct Binding {};
+
+	template< typename Class, typename Member >
+	struct Field {
+		const char *key;
+		Member Class::*member;
+	};
+
+	template< typename Class, typename Member >
+	constexpr Field< Class, Member > field( const char *key, Member Class::*member ) {
+		return Field< Class, Member >{ key, member };
+	}
+
+#define WML_FIELD( type, member ) ::wml::field( #member, &type::member )
+
+	namespace detail {
+		constexpr uint32_t hashKey( std::string_view key, uint32_t seed ) {
+			// FNV-1a
+			uint32_t hash = 2166136261u ^ seed;
+			for( size_t i = 0 ; i < key.size() ; ++i ) {
+				hash ^= (unsigned char) key[ i ];
+				hash *= 16777619u;
+			}
+			return hash;
+		}
+
+		// collision-free hash table for a fixed set of keys (found at compile time)
+		template< size_t N >
+		struct PerfectHash {
+			static constexpr size_t NONE = size_t( -1 );
+
+			static constexpr size_t tableSize() {
+				// ~N^2 slots make collisions unlikely, so a seed is found after very few tries
+				size_t size = 1;
+				while( size < N * N ) {
+					size *= 2;
+				}
+				return size;
+			}
+
+			std::array< std::string_view, N > keys;
+			uint32_t seed;
+			// index + 1 of the key in each slot (0 = empty)
+			std::array< uint16_t, tableSize() > slots;
+
+			constexpr size_t find( std::string_view key ) const {
+				const size_t index = size_t( slots[ hashKey( key, seed ) & ( tableSize() - 1 ) ] ) - 1;
+				if( index < N && keys[ index ] == key ) {
+					return index;
+				}
+				return NONE;
+			}
+
+			constexpr PerfectHash( const std::array< std::string_view, N > &keys ) : keys( keys ), seed( 0 ), slots() {
+				for( size_t i = 0 ; i < N ; ++i ) {
+					for( size_t j = 0 ; j < i ; ++j ) {
+						if( keys[ i ] == keys[ j ] ) {
+							throw "duplicate key in Binding!";
+						}
+					}
+				}
+
+				while( true ) {
+					slots = std::array< uint16_t, tableSize() >();
+
+					bool isPerfect = true;
+					for( size_t i = 0 ; i < N && isPerfect ; ++i ) {
+						uint16_t &slot = slots[ hashKey( keys[ i ], seed ) & ( tableSize() - 1 ) ];
+						if( slot ) {
+							isPerfect = false;
+						}
+						slot = uint16_t( i + 1 );
+					}
+
+					if( isPerfect ) {
+						break;
+					}
+					++seed;
+				}
+			}
+		};
+
+		template< typename T, typename Enable = void >
+		struct HasBinding : std::false_type {};
+
+		template< typename T >
+		struct HasBinding< T, decltype( (void) Binding< T >::fields ) > : std::true_type {};
+
+		// field kinds (see Binding)
+		template< typename T >
+		struct FieldTraits {
+			static constexpr bool isRequired = true;
+			static constexpr bool isRepeatable = false;
+		};
+
+		template< typename T >
+		struct FieldTraits< std::optional< T > > {
+			static constexpr bool isRequired = false;
+			static constexpr bool isRepeatable = false;
+		};
+
+		template< typename T, typename Allocator >
+		struct FieldTraits< std::vector< T, Allocator > > {
+			static constexpr bool isRequired = false;
+			static constexpr bool isRepeatable = true;
+		};
+
+		template< typename MemberPointer >
+		struct MemberType;
+
+		template< typename Class, typename Member >
+		struct MemberType< Member Class::* > {
+			typedef Member type;
+		};
+
+		template< typename T, size_t I >
+		struct FieldType {
+			typedef typename MemberType< typename std::decay< decltype( std::get< I >( Binding< T >::fields ).member ) >::type >::type type;
+		};
+
+		template< typename T, size_t... I >
+		constexpr PerfectHash< sizeof...( I ) > makeKeyHash( std::index_sequence< I... > ) {
+			return PerfectHash< sizeof...( I ) >( std::array< std::string_view, sizeof...( I ) >{ { std::string_view( std::get< I >( Binding< T >::fields ).key )... } } );
+		}
+
+		// bit mask of the required (or repeatable) fields
+		template< typename T, size_t... I >
+		constexpr uint64_t makeFieldMask( std::index_sequence< I... >, bool required ) {
+			const bool flags[] = { ( required ? FieldTraits< typename FieldType< T, I >::type >::isRequired : FieldTraits< typename FieldType< T, I >::type >::isRepeatable )..., false };
+
+			uint64_t mask = 0;
+			for( size_t i = 0 ; i < sizeof...( I ) ; ++i ) {
+				if( flags[ i ] ) {
+					mask |= uint64_t( 1 ) << i;
+				}
+			}
+			return mask;
+		}
+
+		struct Deserializer;
+
+		// a struct, field or array element that is being filled
+		struct Frame;
+
+		struct FrameType {
+			void (*beginEntry)( Deserializer &deserializer, Frame &frame, std::string &&key, const LeanTextProcessing::TextIterator &position );
+			void (*value)( Deserializer &deserializer, Frame &frame, std::string &&value, const LeanTextProcessing::TextIterator &position );
+			void (*endEntry)( Deserializer &deserializer, Frame &frame );
+		};
+
+		struct Frame {
+			const FrameType *type;
+			void *target;
+			// position of the key (for errors)
+			LeanTextProcessing::TextPosition position;
+			// keys seen so far (structs) or number of values (everything else)
+			uint64_t seen;
+		};
+
+		// parser handler that fills objects directly
+		struct Deserializer {
+			const LeanTextProcessing::TextContainer &textContainer;
+			std::vector< Frame > frames;
+
+			void push( const FrameType &type, void *target, const LeanTextProcessing::TextPosition &position ) {
+				Frame frame = { &type, target, position, 0 };
+				frames.push_back( frame );
+			}
+
+			void beginEntry( std::string &&key, const LeanTextProcessing::TextIterator &position ) {
+				Frame &frame = frames.back();
+				frame.type->beginEntry( *this, frame, std::move( key ), position );
+			}
+
+			void value( std::string &&value, const LeanTextProcessing::TextIterator &position ) {
+				Frame &frame = frames.back();
+				frame.type->value( *this, frame, std::move( value ), position );
+			}
+
+			void endEntry( const LeanTextProcessing::TextIterator & ) {
+				Frame &frame = frames.back();
+				frame.type->endEntry( *this, frame );
+				frames.pop_back();
+			}
+
+			void error( const LeanTextProcessing::TextPosition &position, const std::string &message ) const {
+				throw LeanTextProcessing::TextException( LeanTextProcessing::TextContext( LeanTextProcessing::TextIterator( textContainer, position ) ), message );
+			}
+
+			Deserializer( const LeanTextProcessing::TextContainer &textContainer ) : textContainer( textContainer ) {}
+		};
+
+		// default handlers
+		inline void unexpectedMap( Deserializer &deserializer, Frame &, std::string &&key, const LeanTextProcessing::TextIterator &position ) {
+			deserializer.error( position.current, boost::str( boost::format( "expected values, found map entry '%s'!" ) % key ) );
+		}
+
+		inline void unexpectedValue( Deserializer &deserializer, Frame &, std::string &&value, const LeanTextProcessing::TextIterator &position ) {
+			deserializer.error( position.current, boost::str( boost::format( "expected map, found value '%s'!" ) % value ) );
+		}
+
+		inline void ignoreEnd( Deserializer &, Frame & ) {}
+
+		template< typename T >
+		void convertValue( Deserializer &deserializer, const std::string &text, T &value, const LeanTextProcessing::TextIterator &position ) {
+			if( !Converter< T >::parse( text, value ) ) {
+				deserializer.error( position.current, boost::str( boost::format( "cannot convert '%s' to %s!" ) % text % typeName< T >() ) );
+			}
+		}
+
+		template< typename T, typename Enable = void >
+		struct Binder;
+
+		// T with a Converter: exactly one value
+		template< typename T, typename Enable >
+		struct Binder {
+			static void value( Deserializer &deserializer, Frame &frame, std::string &&value, const LeanTextProcessing::TextIterator &position ) {
+				if( frame.seen++ ) {
+					deserializer.error( position.current, "expected only one value!" );
+				}
+				convertValue( deserializer, value, *static_cast< T * >( frame.target ), position );
+			}
+
+			static void endEntry( Deserializer &deserializer, Frame &frame ) {
+				if( !frame.seen ) {
+					deserializer.error( frame.position, "expected a value!" );
+				}
+			}
+
+			static void enter( Deserializer &deserializer, T &target, const LeanTextProcessing::TextPosition &position ) {
+				static const FrameType type = { &unexpectedMap, &Binder::value, &Binder::endEntry };
+				deserializer.push( type, &target, position );
+			}
+		};
+
+		template< typename T >
+		struct Binder< std::optional< T > > {
+			static void enter( Deserializer &deserializer, std::optional< T > &target, const LeanTextProcessing::TextPosition &position ) {
+				Binder< T >::enter( deserializer, target.emplace(), position );
+			}
+		};
+
+		template< typename T, typename Allocator >
+		struct Binder< std::vector< T, Allocator > > {
+			typedef std::vector< T, Allocator > Vector;
+
+			// values are collected unless the elements are maps/lists themselves
+			static constexpr bool collectsValues = !HasBinding< T >::value && !FieldTraits< T >::isRepeatable;
+
+			static void value( Deserializer &deserializer, Frame &frame, std::string &&value, const LeanTextProcessing::TextIterator &position ) {
+				T element = T();
+				convertValue( deserializer, value, element, position );
+				static_cast< Vector * >( frame.target )->push_back( element );
+			}
+
+			static void enter( Deserializer &deserializer, Vector &target, const LeanTextProcessing::TextPosition &position ) {
+				if constexpr( collectsValues ) {
+					static const FrameType type = { &unexpectedMap, &Binder::value, &ignoreEnd };
+					deserializer.push( type, &target, position );
+				}
+				else {
+					target.emplace_back();
+					Binder< T >::enter( deserializer, target.back(), position );
+				}
+			}
+		};
+
+		// structs with a Binding: maps
+		template< typename T >
+		struct Binder< T, typename std::enable_if< HasBinding< T >::value >::type > {
+			typedef typename std::decay< decltype( Binding< T >::fields ) >::type Fields;
+			static constexpr size_t numFields = std::tuple_size< Fields >::value;
+
+			static_assert( numFields <= 64, "Binding supports at most 64 fields" );
+
+			static constexpr PerfectHash< numFields > hash = makeKeyHash< T >( std::make_index_sequence< numFields >() );
+			static constexpr uint64_t requiredFields = makeFieldMask< T >( std::make_index_sequence< numFields >(), true );
+			static constexpr uint64_t repeatableFields = makeFieldMask< T >( std::make_index_sequence< numFields >(), false );
+
+			template< size_t I >
+			static void enterField( Deserializer &deserializer, T &object, const LeanTextProcessing::TextPosition &position ) {
+				auto &member = object.*( std::get< I >( Binding< T >::fields ).member );
+				Binder< typename FieldType< T, I >::type >::enter( deserializer, member, position );
+			}
+
+			template< size_t... I >
+			static void enterFieldAt( size_t index, Deserializer &deserializer, T &object, const LeanTextProcessing::TextPosition &position, std::index_sequence< I... > ) {
+				typedef void (*EnterField)( Deserializer &, T &, const LeanTextProcessing::TextPosition & );
+				static const EnterField enterFields[] = { &Binder::enterField< I >..., nullptr };
+				enterFields[ index ]( deserializer, object, position );
+			}
+
+			static void beginEntry( Deserializer &deserializer, Frame &frame, std::string &&key, const LeanTextProcessing::TextIterator &position ) {
+				const size_t index = hash.find( key );
+				if( index == hash.NONE ) {
+					deserializer.error( position.current, boost::str( boost::format( "unknown key '%s'!" ) % key ) );
+				}
+
+				const uint64_t bit = uint64_t( 1 ) << index;
+				if( ( frame.seen & bit ) && !( repeatableFields & bit ) ) {
+					deserializer.error( position.current, boost::str( boost::format( "duplicate key '%s'!" ) % key ) );
+				}
+				frame.seen |= bit;
+
+				// this invalidates frame
+				enterFieldAt( index, deserializer, *static_cast< T * >( frame.target ), position.current, std::make_index_sequence< numFields >() );
+			}
+
+			static void endEntry( Deserializer &deserializer, Frame &frame ) {
+				const uint64_t missing = requiredFields & ~frame.seen;
+				if( missing ) {
+					size_t index = 0;
+					while( !( missing & ( uint64_t( 1 ) << index ) ) ) {
+						++index;
+					}
+					deserializer.error( frame.position, boost::str( boost::format( "missing key '%s'!" ) % hash.keys[ index ] ) );
+				}
+			}
+
+			static void enter( Deserializer &deserializer, T &target, const LeanTextProcessing::TextPosition &position ) {
+				static const FrameType type = { &Binder::beginEntry, &unexpectedValue, &Binder::endEntry };
+				deserializer.push( type, &target, position );
+			}
+		};
+	}
+
+	// parses a document straight into object (see Binding)
+	// keys that are not in the document keep their value in object
+	template< typename T >
+	void parseInto( T &object, std::string_view content, const std::string &sourceIdentifier = "" ) {
+		static_assert( detail::HasBinding< T >::value, "parseInto requires a Binding specialization" );
+
+		LeanTextProcessing::TextContainer textContainer( content, sourceIdentifier );
+
+		detail::Deserializer deserializer( textContainer );
+		detail::Binder< T >::enter( deserializer, object, LeanTextProcessing::TextPosition() );
+
+		detail::Parser< detail::Deserializer > parser( deserializer, textContainer );
+		parser.parseNode();
+
+		deserializer.endEntry( parser.textIterator );
+	}
+
+	template< typename T >
+	T parseAs( std::string_view content, const std::string &sourceIdentifier = "" ) {
+		T object = T();
+		parseInto( object, content, sourceIdentifier );
+		return object;
+	}
+
+	// a missing file is treated like an empty document
+	template< typename T >
+	T parseFileAs( const std::string &filename ) {
+		std::ifstream file( filename, std::ios_base::binary );
+		const std::string content = std::string( std::istreambuf_iterator<char>( file ), std::istreambuf_iterator<char>() );
+		return parseAs< T >( content, filename );
+	}
+}
@@ -0,0 +1,236 @@
+/*
+Copyright 2013 Andreas Kirsch
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <typeinfo>
+#include <boost/lexical_cast.hpp>
+#include <boost/core/demangle.hpp>
+
+namespace wml {
+	// converts values from and to their text representation (used by Node::as, setValue and push_back)
+	//
+	// specialize Converter for your own types:
+	//	template<> struct Converter< MyType > {
+	//		// returns false if text isn't a valid MyType
+	//		static bool parse( std::string_view text, MyType &value );
+	//		static void format( const MyType &value, std::string &text );
+	//	};
+	//
+	// types without a specialization fall back to boost::lexical_cast
+	template< typename T, typename Enable = void >
+	struct Converter {
+		static bool parse( std::string_view text, T &value ) {
+			return boost::conversion::try_lexical_convert( text.data(), text.size(), value );
+		}
+
+		static void format( const T &value, std::string &text ) {
+			text = boost::lexical_cast< std::string >( value );
+		}
+	};
+
+	namespace detail {
+		// from_chars doesn't accept a leading '+'
+		inline std::string_view skipPlusSign( std::string_view text ) {
+			if( text.size() > 1 && text[0] == '+' && text[1] != '-' ) {
+				text.remove_prefix( 1 );
+			}
+			return text;
+		}
+
+		template< typename T >
+		bool parseNumber( std::string_view text, T &value ) {
+			text = skipPlusSign( text );
+
+			const char *last = text.data() + text.size();
+			const std::from_chars_result result = std::from_chars( text.data(), last, value );
+			return result.ec == std::errc() && result.ptr == last;
+		}
+
+		// integers are parsed 8 digits at a time (SWAR) and fall back to from_chars for long numbers
+		namespace swar {
+			inline bool isLittleEndian() {
+				const uint16_t probe = 1;
+				unsigned char firstByte;
+				std::memcpy( &firstByte, &probe, 1 );
+				return firstByte == 1;
+			}
+
+			inline uint64_t load( const char *text ) {
+				uint64_t word;
+				std::memcpy( &word, text, sizeof( word ) );
+				return word;
+			}
+
+			inline bool isEightDigits( uint64_t word ) {
+				return (((word & 0xF0F0F0F0F0F0F0F0ull) | (((word + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) == 0x3333333333333333ull);
+			}
+
+			// the first digit is the lowest byte (little endian)
+			inline uint32_t parseEightDigits( uint64_t word ) {
+				const uint64_t mask = 0x000000FF000000FFull;
+				const uint64_t mul1 = 0x000F424000000064ull; // 100 + (1000000ULL << 32)
+				const uint64_t mul2 = 0x0000271000000001ull; // 1 + (10000ULL << 32)
+				word -= 0x3030303030303030ull;
+				word = (word * 10) + (word >> 8);
+				return uint32_t( (((word & mask) * mul1) + (((word >> 16) & mask) * mul2)) >> 32 );
+			}
+		}
+
+		template< typename T >
+		bool parseInteger( std::string_view text, T &value ) {
+			typedef typename std::make_unsigned< T >::type Unsigned;
+
+			const char *current = text.data();
+			const char *last = current + text.size();
+
+			bool negative = false;
+			if( current != last && (*current == '-' || *current == '+') ) {
+				negative = *current == '-';
+				++current;
+			}
+
+			// uint64_t can hold any number with 19 digits
+			const size_t numDigits = last - current;
+			if( numDigits == 0 || numDigits > 19 ) {
+				return parseNumber( text, value );
+			}
+
+			uint64_t magnitude = 0;
+			if( swar::isLittleEndian() ) {
+				for( ; last - current >= 8 ; current += 8 ) {
+					const uint64_t word = swar::load( current );
+					if( !swar::isEightDigits( word ) ) {
+						return false;
+					}
+					magnitude = magnitude * 100000000 + swar::parseEightDigits( word );
+				}
+			}
+			for( ; current != last ; ++current ) {
+				const unsigned digit = unsigned( *current - '0' );
+				if( digit > 9 ) {
+					return false;
+				}
+				magnitude = magnitude * 10 + digit;
+			}
+
+			const uint64_t maximum = uint64_t( std::numeric_limits< T >::max() );
+			if( negative ) {
+				if( !std::is_signed< T >::value || magnitude > maximum + 1 ) {
+					return false;
+				}
+				value = T( Unsigned( 0 ) - Unsigned( magnitude ) );
+			}
+			else {
+				if( magnitude > maximum ) {
+					return false;
+				}
+				value = T( magnitude );
+			}
+			return true;
+		}
+
+		template< typename T >
+		void formatNumber( const T &value, std::string &text ) {
+			// enough for the shortest representation of any double
+			char buffer[ 64 ];
+			const std::to_chars_result result = std::to_chars( buffer, buffer + sizeof( buffer ), value );
+			text.assign( buffer, result.ptr );
+		}
+
+		template< typename T >
+		struct IsCharacter {
+			static const bool value =
+				std::is_same< T, char >::value ||
+				std::is_same< T, signed char >::value ||
+				std::is_same< T, unsigned char >::value;
+		};
+
+		template< typename T >
+		std::string typeName() {
+			return boost::core::demangle( typeid( T ).name() );
+		}
+	}
+
+	// integers (characters are converted as characters like with lexical_cast)
+	template< typename T >
+	struct Converter< T, typename std::enable_if< std::is_integral< T >::value && !std::is_same< T, bool >::value && !detail::IsCharacter< T >::value >::type > {
+		static bool parse( std::string_view text, T &value ) {
+			return detail::parseInteger( text, value );
+		}
+
+		static void format( const T &value, std::string &text ) {
+			detail::formatNumber( value, text );
+		}
+	};
+
+	// floating point numbers are formatted with the shortest representation that converts back exactly
+	template< typename T >
+	struct Converter< T, typename std::enable_if< std::is_floating_point< T >::value >::type > {
+		static bool parse( std::string_view text, T &value ) {
+			return detail::parseNumber( text, value );
+		}
+
+		static void format( const T &value, std::string &text ) {
+			detail::formatNumber( value, text );
+		}
+	};
+
+	// accepts true/false and 1/0, writes 1/0 (as the stream conversion did, so existing files keep their values)
+	template<>
+	struct Converter< bool > {
+		static bool parse( std::string_view text, bool &value ) {
+			if( text == "true" || text == "1" ) {
+				value = true;
+				return true;
+			}
+			if( text == "false" || text == "0" ) {
+				value = false;
+				return true;
+			}
+			return false;
+		}
+
+		static void format( const bool &value, std::string &text ) {
+			text = value ? "1" : "0";
+		}
+	};
+
+	template<>
+	struct Converter< std::string > {
+		static bool parse( std::string_view text, std::string &value ) {
+			value.assign( text.data(), text.size() );
+			return true;
+		}
+
+		static void format( const std::string &value, std::string &text ) {
+			text = value;
+		}
+	};
+}
@@ -22,19 +22,165 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 // for emitFile
 #include <fstream>
+#include <functional>
+#include <memory>
+#include <cstring>
+#include <algorithm>
+#include <cerrno>
+#include <thread>
+#include <atomic>
+#include <exception>
+#ifdef _WIN32
+#	include <io.h>
+#else
+#	include <unistd.h>
+#	include <sys/uio.h>
+#	include <climits>
+#endif
+
+#include "wml_stats.h"
+#include "wml_trace.h"
 
 namespace wml {
 	namespace detail {
+		// emitter outputs
+
+		// collects everything in memory
+		struct StringOutput {
+			std::string text;
+
+			void push_back( char c ) {
+				text.push_back( c );
+			}
+
+			void append( const char *data, size_t size ) {
+				text.append( data, size );
+			}
+		};
+
+		// passes the text on in chunks of at most bufferSize bytes (only big values are passed on directly)
+		struct BufferedOutput {
+			typedef std::function< void ( const char *data, size_t size ) > Write;
+
+			Write write;
+			std::unique_ptr< char[] > buffer;
+			size_t bufferSize;
+			size_t used;
+
+			void push_back( char c ) {
+				if( used == bufferSize ) {
+					flush();
+				}
+				buffer[ used++ ] = c;
+			}
+
+			void append( const char *data, size_t size ) {
+				if( size > bufferSize - used ) {
+					flush();
+
+					if( size >= bufferSize ) {
+						write( data, size );
+						return;
+					}
+				}
+
+				memcpy( buffer.get() + used, data, size );
+				used += size;
+			}
+
+			void flush() {
+				if( used ) {
+					write( buffer.get(), used );
+					used = 0;
+				}
+			}
+
+			// note: call flush() at the end
+			// bufferSize 0 is treated as 1 (push_back needs room for a character)
+			BufferedOutput( const Write &write, size_t bufferSize )
+				: write( write ), buffer( new char[ std::max< size_t >( bufferSize, 1 ) ] ), bufferSize( std::max< size_t >( bufferSize, 1 ) ), used( 0 ) {}
+		};
+
+		// only counts the characters
+		struct CountingOutput {
+			size_t size;
+
+			void push_back( char ) {
+				++size;
+			}
+
+			void append( const char *, size_t size ) {
+				this->size += size;
+			}
+
+			CountingOutput() : size( 0 ) {}
+		};
+
+		// writes into a fixed buffer and counts what doesn't fit
+		struct FixedOutput {
+			char *buffer;
+			size_t capacity;
+			size_t size;
+
+			void push_back( char c ) {
+				if( size < capacity ) {
+					buffer[ size ] = c;
+				}
+				++size;
+			}
+
+			void append( const char *data, size_t size ) {
+				if( this->size < capacity ) {
+					memcpy( buffer + this->size, data, std::min( size, capacity - this->size ) );
+				}
+				this->size += size;
+			}
+
+			FixedOutput( char *buffer, size_t capacity ) : buffer( buffer ), capacity( capacity ), size( 0 ) {}
+		};
+
+		// writes all of data to a file descriptor (retries partial writes)
+		inline bool writeToDescriptor( int fileDescriptor, const char *data, size_t size ) {
+			while( size ) {
+#ifdef _WIN32
+				const int written = _write( fileDescriptor, data, (unsigned int) std::min< size_t >( size, 1 << 30 ) );
+#else
+				const ssize_t written = ::write( fileDescriptor, data, size );
+#endif
+				if( written < 0 ) {
+					if( errno == EINTR ) {
+						continue;
+					}
+					return false;
+				}
+
+				data += written;
+				size -= written;
+			}
+			return true;
+		}
+
+		template< typename Output >
 		struct Emitter {
 			int indentLevel;
-			std::string text;
+			Output &output;
 
-			Emitter() : indentLevel( 0 ) {}
+			// see Stats
+			size_t escapedStrings;
+			size_t textBlocks;
+
+			Emitter( Output &output ) : indentLevel( 0 ), output( output ), escapedStrings( 0 ), textBlocks( 0 ) {}
 
 			void emitTabs() {
-				for( int i = 0 ; i < indentLevel ; ++i ) {
-					text.push_back( '\t' );
+				static const char tabs[] = "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t";
+				const size_t numTabs = sizeof( tabs ) - 1;
+
+				size_t remaining = indentLevel;
+				while( remaining > numTabs ) {
+					output.append( tabs, numTabs );
+					remaining -= numTabs;
 				}
+				output.append( tabs, remaining );
 			}
 
 			enum ValueType {
@@ -44,154 +190,707 @@ namespace wml {
 				VT_TEXT
 			};
 
-			static ValueType determineType( const std::string &value ) {
-				int numLines = 1;
+			// character classes for determineType
+			enum CharacterFlags {
+				// only possible in escaped strings (even in text blocks)
+				CF_CONTROL = 1,
+				CF_NEWLINE = 2,
+				// needs an escaped string (unless in text blocks)
+				CF_ESCAPE = 4,
+				// needs quotes
+				CF_QUOTE = 8
+			};
+
+			static const unsigned char *characterFlags() {
+				static const struct Table {
+					unsigned char entries[ 256 ];
+
+					Table() : entries() {
+						entries[ (unsigned char) '\0' ] = CF_CONTROL;
+						entries[ (unsigned char) '\r' ] = CF_CONTROL;
+						entries[ (unsigned char) '\n' ] = CF_NEWLINE;
+						entries[ (unsigned char) '\t' ] = CF_ESCAPE;
+						entries[ (unsigned char) '\'' ] = CF_ESCAPE;
+						entries[ (unsigned char) ' ' ] = CF_QUOTE;
+						entries[ (unsigned char) ':' ] = CF_QUOTE;
+					}
+				} table;
 
+				return table.entries;
+			}
+
+			// classifies the value in one pass
+			static ValueType determineType( std::string_view value ) {
 				if( value.empty() ) {
 					return VT_UNESCAPED_STRING;
 				}
 
-				// null characters or special characters => VT_ESCAPED_STRING
-				for( auto c = value.cbegin() ; c != value.cend() ; ++c ) {
-					if( *c == 0 || *c == '\r' ) {
-						return VT_ESCAPED_STRING;
-					}
-				}
+				const unsigned char *flags = characterFlags();
 
+				unsigned char found = 0;
+				size_t numNewlines = 0;
 				for( auto c = value.cbegin() ; c != value.cend() ; ++c ) {
-					if( *c == '\n' ) {
-						numLines++;
-					}
+					const unsigned char flag = flags[ (unsigned char) *c ];
+					found |= flag;
+					numNewlines += flag == CF_NEWLINE;
 				}
 
+				// null characters or special characters => VT_ESCAPED_STRING
+				if( found & CF_CONTROL ) {
+					return VT_ESCAPED_STRING;
+				}
 				// raw text only for more than 2 lines
-				if( numLines > 2 ) {
+				if( numNewlines >= 2 ) {
 					return VT_TEXT;
 				}
+				if( found & ( CF_NEWLINE | CF_ESCAPE ) ) {
+					return VT_ESCAPED_STRING;
+				}
+				if( found & CF_QUOTE ) {
+					return VT_UNESCAPED_STRING;
+				}
+				return VT_IDENTIFIER;
+			}
 
-				for( auto c = value.cbegin() ; c != value.cend() ; ++c ) {
-					if( *c == '\n' || *c == '\t' || *c == '\'' ) {
-						return VT_ESCAPED_STRING;
+			// escape character for every character that needs to be escaped (or 0)
+			static const char *escapeCharacters() {
+				static const struct Table {
+					char entries[ 256 ];
+
+					Table() : entries() {
+						entries[ (unsigned char) '\\' ] = '\\';
+						entries[ (unsigned char) '\"' ] = '\"';
+						entries[ (unsigned char) '\t' ] = 't';
+						entries[ (unsigned char) '\n' ] = 'n';
+						entries[ (unsigned char) '\r' ] = 'r';
+						entries[ (unsigned char) '\0' ] = '0';
+					}
+				} table;
+
+				return table.entries;
+			}
+
+			void emitEscapedString( std::string_view value ) {
+				const char *escapes = escapeCharacters();
+
+				++escapedStrings;
+				output.push_back( '\"' );
+
+				// copy runs of characters that don't need escaping at once
+				const char *run = value.data();
+				const char *end = value.data() + value.size();
+				for( const char *c = run ; c != end ; ++c ) {
+					const char escape = escapes[ (unsigned char) *c ];
+					if( escape ) {
+						output.append( run, c - run );
+						const char escaped[] = { '\\', escape };
+						output.append( escaped, 2 );
+						run = c + 1;
 					}
 				}
+				output.append( run, end - run );
 
-				for( auto c = value.cbegin() ; c != value.cend() ; ++c ) {
-					if( *c == ' ' || *c == ':' ) {
-						return VT_UNESCAPED_STRING;
-					} 
+				output.push_back( '\"' );
+			}
+
+			void emitTextBlock( std::string_view value ) {
+				++textBlocks;
+				output.append( "::\n", 3 );
+
+				++indentLevel;
+
+				emitTabs();
+				// copy line by line
+				size_t lineStart = 0;
+				for( size_t newline = value.find( '\n' ) ; newline != std::string_view::npos ; newline = value.find( '\n', lineStart ) ) {
+					output.append( value.data() + lineStart, newline + 1 - lineStart );
+					emitTabs();
+					lineStart = newline + 1;
 				}
+				output.append( value.data() + lineStart, value.size() - lineStart );
 
-				return VT_IDENTIFIER;
+				output.push_back( '\n' );
+				--indentLevel;
 			}
 
-			void emitValue( const std::string &value, bool noTextBlocks ) {
+			// emits value as vt (see determineType)
+			void emitValue( std::string_view value, ValueType vt ) {
+				if( vt == VT_IDENTIFIER ) {
+					output.append( value.data(), value.size() );
+				}
+				else if( vt == VT_UNESCAPED_STRING ) {
+					output.push_back( '\'' );
+					output.append( value.data(), value.size() );
+					output.push_back( '\'' );
+				}
+				else if( vt == VT_TEXT ) {
+					emitTextBlock( value );
+				}
+				else if( vt == VT_ESCAPED_STRING ) {
+					emitEscapedString( value );
+				}
+			}
+
+			void emitValue( std::string_view value, bool noTextBlocks ) {
 				ValueType vt = determineType( value );
 
 				if( vt == VT_TEXT && noTextBlocks ) {
 					vt = VT_ESCAPED_STRING;
 				}
 
-				if( vt == VT_IDENTIFIER ) {
-					text.append( value );
+				emitValue( value, vt );
+			}
+
+			template< typename NodeT >
+			static bool isMap( const NodeT &node ) {
+				// packed children are always leaves
+				if( node.packed ) {
+					return false;
 				}
-				else if( vt == VT_UNESCAPED_STRING ) {
-					text.push_back( '\'' );
-					text.append( value );
-					text.push_back( '\'' );
+
+				for( auto item = node.nodes.begin() ; item != node.nodes.end() ; ++item ) {
+					if( !item->empty() ) {
+						return true;
+					}
 				}
-				else if( vt == VT_TEXT ) {
-					text.append( "::\n" );
+				return false;
+			}
 
-					++indentLevel;
+			template< typename NodeT >
+			void emitInlineValues( const NodeT &node ) {
+				for( auto value : node.values() ) {
+					output.push_back( ' ' );
 
-					emitTabs();
-					for( auto c = value.cbegin() ; c != value.cend() ; ++c ) {
-						text.push_back( *c );
-						if( *c == '\n' ) {
-							emitTabs();
-						}
-					}				
+					emitValue( value, true );
+				}
+				output.push_back( '\n' );
+			}
+
+			template< typename NodeT >
+			void emitNode( const NodeT &node ) {
+				emitEntries( node, 0, node.size() );
+			}
+
+			// emits the children [begin, end) of node
+			template< typename NodeT >
+			void emitEntries( const NodeT &node, size_t begin, size_t end ) {
+				const typename NodeT::NodeContainer &items = node.childNodes();
+				for( size_t i = begin ; i < end ; ++i ) {
+					emitEntry( items[ i ] );
+				}
+			}
 
-					text.push_back( '\n' );
+			// the first line of a map entry
+			void emitMapHeader( std::string_view key ) {
+				emitTabs();
+				emitValue( key, true );
+				output.append( ":\n", 2 );
+			}
+
+			template< typename NodeT >
+			void emitEntry( const NodeT &item ) {
+				if( isMap( item ) ) {
+					WML_TRACE_SCOPE_IF( indentLevel < WML_TRACE_DEPTH, "emitMap", textContext( item.context ).position.line );
+
+					emitMapHeader( item.content );
+					++indentLevel;
+					emitNode( item );
 					--indentLevel;
+					return;
 				}
-				else if( vt == VT_ESCAPED_STRING ) {
-					text.push_back( '\"' );
 
-					for( auto c = value.cbegin() ; c != value.cend() ; ++c ) {
-						if( *c == '\\' || *c == '\"' ) {
-							text.push_back( '\\' );
-							text.push_back( *c );
-						}
-						else if( *c == '\t' ) {
-							text.append( "\\t" );
-						}
-						else if( *c == '\n' ) {
-							text.append( "\\n" );
-						}
-						else if( *c == '\r' ) {
-							text.append( "\\r" );
-						}
-						else if( *c == '\0' ) {
-							text.append( "\\0" );
-						}
-						else {
-							text.push_back( *c );
-						}
+				emitTabs();
+				// emit the key
+				emitValue( item.content, true );
+
+				if( item.size() == 1 ) {
+					// classify the value only once
+					const std::string_view value = item.valueAt( 0 );
+					const ValueType vt = determineType( value );
+
+					if( vt == VT_TEXT ) {
+						emitValue( value, VT_TEXT );
 					}
+					else {
+						output.push_back( ' ' );
+						emitValue( value, vt );
+						output.push_back( '\n' );
+					}
+				}
+				else {
+					emitInlineValues( item );
+				}
+			}
+		};
+
+		template< typename NodeT >
+		std::string emit( const NodeT &node, Stats *stats = nullptr ) {
+			StringOutput output;
+			{
+				WML_TRACE_RANGE_SCOPE_IF( true, "emit", 0, output.text.size() );
+				StatsScope scope( stats, &Stats::emitTime );
 
-					text.push_back( '\"' );
+				Emitter< StringOutput > emitter( output );
+				emitter.emitNode( node );
+
+				if( stats ) {
+					stats->escapedStrings += emitter.escapedStrings;
+					stats->textBlocks += emitter.textBlocks;
 				}
 			}
 
-			static bool isMap( const Node &node ) {
-				for( auto item = node.nodes.begin() ; item != node.nodes.end() ; ++item ) {
-					if( !item->empty() ) {
-						return true;
+			if( stats ) {
+				stats->bytes += output.text.size();
+				measureTree( node, 0, *stats );
+			}
+			return std::move( output.text );
+		}
+
+		template< typename NodeT, typename Output >
+		void emit( const NodeT &node, Output &output ) {
+			WML_TRACE_SCOPE( "emit", 0 );
+
+			Emitter< Output > emitter( output );
+			emitter.emitNode( node );
+		}
+
+		template< typename NodeT >
+		void emit( const NodeT &node, const BufferedOutput::Write &write, size_t bufferSize ) {
+			WML_TRACE_SCOPE( "emit", 0 );
+
+			BufferedOutput output( write, bufferSize );
+			Emitter< BufferedOutput > emitter( output );
+			emitter.emitNode( node );
+			output.flush();
+		}
+
+		// passes the text on with every newline replaced by newline (the emitter only writes \n
+		// at the ends of lines: \r and \n in values are escaped and text blocks are split into lines)
+		template< typename Output >
+		struct NewlineOutput {
+			Output &output;
+			std::string_view newline;
+
+			void push_back( char c ) {
+				if( c == '\n' ) {
+					output.append( newline.data(), newline.size() );
+				}
+				else {
+					output.push_back( c );
+				}
+			}
+
+			void append( const char *data, size_t size ) {
+				const char *end = data + size;
+				for( const char *c = data ; c != end ; ) {
+					const char *next = static_cast< const char * >( memchr( c, '\n', end - c ) );
+					if( !next ) {
+						output.append( c, end - c );
+						break;
 					}
+					output.append( c, next - c );
+					output.append( newline.data(), newline.size() );
+					c = next + 1;
 				}
-				return false;
 			}
 
-			static bool isTextBlock( const Node &node ) {
-				return node.size() == 1 && determineType( node.nodes[0].content ) == VT_TEXT;
+			NewlineOutput( Output &output, std::string_view newline ) : output( output ), newline( newline ) {}
+		};
+
+		// emits a parsed tree, copying the source text of all entries that haven't been modified
+		// (see Node::span), so formatting, alignment and empty lines are kept
+		// re-emitted entries use the newlines of the source (the first one decides)
+		template< typename Output >
+		struct PreservingEmitter {
+			static const size_t NONE = size_t( -1 );
+
+			Output &output;
+			NewlineOutput< Output > newlineOutput;
+			Emitter< NewlineOutput< Output > > emitter;
+			std::string_view source;
+			// the last copied text didn't end with a newline (only possible at the end of the source)
+			bool isNewlinePending;
+
+			bool isInSource( const Node &node ) const {
+				return node.span.isValid() && node.span.begin <= node.span.end && node.span.end <= source.size();
 			}
 
-			void emitInlineValues( const Node &node ) {
-				for( auto item = node.nodes.begin() ; item != node.nodes.end() ; ++item ) {
-					text.push_back( ' ' );
+			// true if the source text at the span looks like the entry at indentLevel
+			// (protects against nodes that have been moved or come from another source)
+			bool matchesSource( const Node &item, int indentLevel ) const {
+				size_t position = item.span.begin;
+				for( int i = 0 ; i < indentLevel ; ++i, ++position ) {
+					if( position >= item.span.end || source[ position ] != '\t' ) {
+						return false;
+					}
+				}
+				while( position < item.span.end && ( source[ position ] == ' ' || source[ position ] == '\t' ) ) {
+					if( source[ position ] == '\t' ) {
+						return false;
+					}
+					++position;
+				}
 
-					emitValue( item->content, true );
+				if( position < item.span.end && ( source[ position ] == '\'' || source[ position ] == '"' ) ) {
+					return true;
 				}
-				text.push_back( '\n' );
+				return source.substr( position, item.content.size() ) == item.content;
 			}
 
-			void emitNode( const Node &node ) {
-				for( auto item = node.nodes.begin() ; item != node.nodes.end() ; ++item ) {
-					emitTabs();
-					// emit the key
-					emitValue( item->content, true );
+			bool isUnchanged( const Node &node ) const {
+				if( !isInSource( node ) || !node.span.isUnchanged( node.content ) || node.span.numChildren != node.size() ) {
+					return false;
+				}
+				// packed values are immutable
+				if( node.packed ) {
+					return true;
+				}
+				for( auto child = node.nodes.cbegin() ; child != node.nodes.cend() ; ++child ) {
+					if( !isUnchanged( *child ) ) {
+						return false;
+					}
+				}
+				return true;
+			}
+
+			// end of the first line of the entry (or NONE if it isn't a map header)
+			size_t mapHeaderEnd( const Node &item ) const {
+				const size_t newline = source.find( '\n', item.span.begin );
+				if( newline == std::string_view::npos || newline >= item.span.end ) {
+					return NONE;
+				}
+
+				size_t last = newline;
+				while( last > item.span.begin && ( source[ last - 1 ] == ' ' || source[ last - 1 ] == '\t' || source[ last - 1 ] == '\r' ) ) {
+					--last;
+				}
 
-					if( isMap( *item ) ) {
-						text.append( ":\n" );
-						++indentLevel;
-						emitNode( *item );
-						--indentLevel;
+				// identifiers can't end with ':', so "key:" is a map and "key::" a text block
+				const bool isMapHeader = last - item.span.begin >= 2 && source[ last - 1 ] == ':' && source[ last - 2 ] != ':';
+				return isMapHeader ? newline + 1 : NONE;
+			}
+
+			static bool isBlank( char c ) {
+				return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+			}
+
+			// copies the empty lines in [begin, end) that directly precede end
+			// (the rest of the gap contains entries that have been removed)
+			void copyEmptyLines( size_t begin, size_t end ) {
+				size_t start = end;
+				while( start > begin && isBlank( source[ start - 1 ] ) ) {
+					--start;
+				}
+				if( start > begin ) {
+					// skip the end of the line of the removed entry
+					const size_t newline = source.find( '\n', start );
+					if( newline == std::string_view::npos || newline >= end ) {
+						return;
 					}
-					else if( isTextBlock( *item ) ) {
-						emitValue( item->nodes[0].content, false );
+					start = newline + 1;
+				}
+				copy( start, end );
+			}
+
+			void beginWrite() {
+				if( isNewlinePending ) {
+					newlineOutput.push_back( '\n' );
+					isNewlinePending = false;
+				}
+			}
+
+			void copy( size_t begin, size_t end ) {
+				if( begin == end ) {
+					return;
+				}
+
+				beginWrite();
+				output.append( source.data() + begin, end - begin );
+				isNewlinePending = source[ end - 1 ] != '\n' && source[ end - 1 ] != '\r';
+			}
+
+			// emits the entries of container, the source text [regionBegin, regionEnd) contained them originally
+			void emitEntries( const Node &container, int indentLevel, size_t regionBegin, size_t regionEnd ) {
+				// end of the last entry that came from the source (to copy the empty lines between entries)
+				size_t cursor = regionBegin;
+
+				const Node::NodeContainer &items = container.childNodes();
+				for( auto item = items.cbegin() ; item != items.cend() ; ++item ) {
+					const bool isFromSource = isInSource( *item ) && matchesSource( *item, indentLevel );
+
+					if( isFromSource && cursor != NONE && cursor <= item->span.begin ) {
+						copyEmptyLines( cursor, item->span.begin );
+					}
+
+					size_t headerEnd;
+					if( isFromSource && isUnchanged( *item ) ) {
+						copy( item->span.begin, item->span.end );
+					}
+					else if( isFromSource && Emitter< Output >::isMap( *item ) && ( headerEnd = mapHeaderEnd( *item ) ) != NONE ) {
+						beginWrite();
+						emitter.indentLevel = indentLevel;
+						emitter.emitMapHeader( item->content );
+						emitEntries( *item, indentLevel + 1, headerEnd, item->span.end );
 					}
 					else {
-						emitInlineValues( *item );
+						beginWrite();
+						emitter.indentLevel = indentLevel;
+						emitter.emitEntry( *item );
 					}
+
+					cursor = isFromSource ? item->span.end : NONE;
+				}
+
+				if( cursor != NONE && cursor <= regionEnd ) {
+					copyEmptyLines( cursor, regionEnd );
 				}
 			}
+
+			// \r\n, \r or \n (also for sources without newlines)
+			static std::string_view detectNewline( std::string_view source ) {
+				const size_t newline = source.find_first_of( "\r\n" );
+				if( newline == std::string_view::npos || source[ newline ] == '\n' ) {
+					return "\n";
+				}
+				return newline + 1 < source.size() && source[ newline + 1 ] == '\n' ? "\r\n" : "\r";
+			}
+
+			PreservingEmitter( Output &output, std::string_view source )
+				: output( output ), newlineOutput( output, detectNewline( source ) ), emitter( newlineOutput ), source( source ), isNewlinePending( false ) {}
 		};
 
-		inline std::string emit( const Node &node ) {
-			Emitter emitter;
-			emitter.emitNode( node );
-			return emitter.text;
+		inline std::string emitPreserving( const Node &root, std::string_view source ) {
+			WML_TRACE_SCOPE( "emitPreserving", 0 );
+
+			// the tree doesn't come from this source
+			if( !root.span.isValid() || root.span.end != source.size() ) {
+				return emit( root );
+			}
+
+			StringOutput output;
+			PreservingEmitter< StringOutput > emitter( output, source );
+			emitter.emitEntries( root, 0, 0, source.size() );
+
+			// re-emitted entries end with a newline, but the source might not
+			const std::string_view newline = emitter.newlineOutput.newline;
+			const bool sourceEndsWithNewline = source.empty() || source.back() == '\n' || source.back() == '\r';
+			if( !sourceEndsWithNewline && output.text.size() >= newline.size() && output.text.compare( output.text.size() - newline.size(), newline.size(), newline ) == 0 ) {
+				output.text.resize( output.text.size() - newline.size() );
+			}
+			return std::move( output.text );
+		}
+
+		// splits the emission of a tree into independent parts that can be emitted concurrently
+		// (in document order, so concatenating the parts gives the same text as emit)
+		struct ParallelEmission {
+			struct Part {
+				// the children [begin, end) of node at indentLevel (if node is set)
+				const Node *node;
+				size_t begin, end;
+				int indentLevel;
+
+				// the emitted text (headers of split maps are emitted while planning)
+				std::string text;
+
+				Part( const Node *node, size_t begin, size_t end, int indentLevel ) : node( node ), begin( begin ), end( end ), indentLevel( indentLevel ) {}
+				Part( std::string &&text ) : node( nullptr ), begin( 0 ), end( 0 ), indentLevel( 0 ), text( std::move( text ) ) {}
+			};
+
+			std::vector< Part > parts;
+			size_t targetParts;
+
+			void addText( const Node &item, int indentLevel ) {
+				StringOutput output;
+				Emitter< StringOutput > emitter( output );
+				emitter.indentLevel = indentLevel;
+				emitter.emitMapHeader( item.content );
+
+				// consecutive headers (chains of nested maps) share one part
+				if( !parts.empty() && !parts.back().node ) {
+					parts.back().text.append( output.text );
+				}
+				else {
+					parts.push_back( Part( std::move( output.text ) ) );
+				}
+			}
+
+			void addEntries( const Node &node, size_t begin, size_t end, int indentLevel ) {
+				parts.push_back( Part( &node, begin, end, indentLevel ) );
+			}
+
+			// size of the emitted entry without quotes and escapes (close enough to balance the parts,
+			// counting exactly would mean a sequential pass as expensive as emitting)
+			static size_t estimateSize( const Node &item, int indentLevel ) {
+				size_t size = indentLevel + item.content.size() + 2;
+				if( Emitter< StringOutput >::isMap( item ) ) {
+					for( auto child = item.nodes.cbegin() ; child != item.nodes.cend() ; ++child ) {
+						size += estimateSize( *child, indentLevel + 1 );
+					}
+				}
+				else {
+					for( std::string_view value : item.values() ) {
+						size += value.size() + 1;
+					}
+				}
+				return size;
+			}
+
+			// nodes with many children are split into parts of about the same size (in bytes, so a few
+			// big subtrees don't end up in one part), maps with few children (even chains of maps
+			// with a single child) are split at the next level
+			void plan( const Node &node, int indentLevel ) {
+				const size_t size = node.size();
+				if( size >= targetParts || parts.size() >= 4 * targetParts ) {
+					const Node::NodeContainer &items = node.childNodes();
+
+					std::vector< size_t > sizes( size );
+					size_t totalSize = 0;
+					for( size_t i = 0 ; i < size ; ++i ) {
+						sizes[ i ] = estimateSize( items[ i ], indentLevel );
+						totalSize += sizes[ i ];
+					}
+
+					// chunk k ends with the child that reaches (k + 1) / chunks of the total size
+					const size_t chunks = std::min( size, targetParts );
+					size_t begin = 0, chunk = 1, accumulatedSize = 0;
+					for( size_t i = 0 ; i < size ; ++i ) {
+						accumulatedSize += sizes[ i ];
+						if( accumulatedSize * chunks >= totalSize * chunk || i + 1 == size ) {
+							addEntries( node, begin, i + 1, indentLevel );
+							begin = i + 1;
+							chunk = accumulatedSize * chunks / totalSize + 1;
+						}
+					}
+					return;
+				}
+
+				for( size_t i = 0 ; i < size ; ++i ) {
+					const Node &item = node.childNodes()[ i ];
+					if( Emitter< StringOutput >::isMap( item ) ) {
+						addText( item, indentLevel );
+						plan( item, indentLevel + 1 );
+					}
+					else {
+						addEntries( node, i, i + 1, indentLevel );
+					}
+				}
+			}
+
+			void emit( unsigned numThreads ) {
+				std::atomic< size_t > nextPart( 0 );
+				std::exception_ptr error;
+				std::atomic_flag hasError = ATOMIC_FLAG_INIT;
+
+				auto work = [&] () {
+					try {
+						for( size_t i = nextPart++ ; i < parts.size() ; i = nextPart++ ) {
+							Part &part = parts[ i ];
+							if( part.node ) {
+								WML_TRACE_SCOPE( "emitPart", part.node->childNodes()[ part.begin ].context.position.line );
+
+								StringOutput output;
+								Emitter< StringOutput > emitter( output );
+								emitter.indentLevel = part.indentLevel;
+								emitter.emitEntries( *part.node, part.begin, part.end );
+								part.text = std::move( output.text );
+							}
+						}
+					}
+					catch( ... ) {
+						if( !hasError.test_and_set() ) {
+							error = std::current_exception();
+						}
+					}
+				};
+
+				std::vector< std::thread > threads;
+				threads.reserve( numThreads - 1 );
+				try {
+					for( unsigned i = 1 ; i < numThreads ; ++i ) {
+						threads.emplace_back( work );
+					}
+				}
+				catch( ... ) {
+					// the threads that have been started (and this one) emit all parts
+				}
+				work();
+				for( auto thread = threads.begin() ; thread != threads.end() ; ++thread ) {
+					thread->join();
+				}
+
+				if( error ) {
+					std::rethrow_exception( error );
+				}
+			}
+
+			ParallelEmission( const Node &node, unsigned numThreads ) : targetParts( 4 * numThreads ) {
+				plan( node, 0 );
+				emit( numThreads );
+			}
+		};
+
+		inline std::string emitParallel( const Node &node, unsigned numThreads ) {
+			if( numThreads <= 1 ) {
+				return emit( node );
+			}
+
+			ParallelEmission emission( node, numThreads );
+
+			size_t size = 0;
+			for( auto part = emission.parts.cbegin() ; part != emission.parts.cend() ; ++part ) {
+				size += part->text.size();
+			}
+
+			std::string text;
+			text.reserve( size );
+			for( auto part = emission.parts.cbegin() ; part != emission.parts.cend() ; ++part ) {
+				text.append( part->text );
+			}
+			return text;
+		}
+
+		// writes the parts with as few system calls as possible (without joining them)
+		inline bool emitParallel( const Node &node, int fileDescriptor, unsigned numThreads ) {
+			ParallelEmission emission( node, std::max( numThreads, 1u ) );
+			const std::vector< ParallelEmission::Part > &parts = emission.parts;
+
+#ifdef _WIN32
+			for( auto part = parts.cbegin() ; part != parts.cend() ; ++part ) {
+				if( !writeToDescriptor( fileDescriptor, part->text.data(), part->text.size() ) ) {
+					return false;
+				}
+			}
+#else
+			std::vector< iovec > vectors;
+			for( auto part = parts.cbegin() ; part != parts.cend() ; ++part ) {
+				if( !part->text.empty() ) {
+					iovec vector = { const_cast< char * >( part->text.data() ), part->text.size() };
+					vectors.push_back( vector );
+				}
+			}
+
+			for( size_t first = 0 ; first < vectors.size() ; ) {
+				const int count = int( std::min< size_t >( vectors.size() - first, IOV_MAX ) );
+				ssize_t written = ::writev( fileDescriptor, &vectors[ first ], count );
+				if( written < 0 ) {
+					if( errno == EINTR ) {
+						continue;
+					}
+					return false;
+				}
+
+				// skip everything that has been written (partial writes continue in the middle of a part)
+				while( first < vectors.size() && written >= ssize_t( vectors[ first ].iov_len ) ) {
+					written -= vectors[ first ].iov_len;
+					++first;
+				}
+				if( written > 0 ) {
+					vectors[ first ].iov_base = static_cast< char * >( vectors[ first ].iov_base ) + written;
+					vectors[ first ].iov_len -= written;
+				}
+			}
+#endif
+			return true;
 		}
 	}
 }
\ No newline at end of file
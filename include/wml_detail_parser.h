@@ -22,14 +22,84 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 // for parseFile and parse (stream overload)
 #include <istream>
+#include <algorithm>
+
+#include "wml_stats.h"
+#include "wml_trace.h"
 
 namespace wml {
+	struct ParseOptions {
+		// inline value lists with at least this many numbers (0 = never, lists of single values are never packed) are stored packed
+		// in one buffer instead of one child node per value (see Node::packed)
+		// use Node::asArray or Node::readInto to convert them in bulk
+		size_t packedNumberLists;
+		// the same for inline value lists of any kind (at least 2 values)
+		// the values are read with the normal rules (quotes, escapes), so this is slower than packedNumberLists
+		size_t packedValueLists;
+		// record where the entries are in the source (Node::span), which emitPreserving needs
+		// off by default: it costs a hash and a scan to the start of the line for every entry
+		// (inputs of 4 GiB and more are never tracked)
+		bool trackSourceSpans;
+
+		ParseOptions() : packedNumberLists( 0 ), packedValueLists( 0 ), trackSourceSpans( false ) {}
+	};
+
 	namespace detail {
 		using namespace LeanTextProcessing;
 
+		bool isNumberCharacter( char c );
+		bool isNumber( std::string_view text );
+
+		// calls f( value ) for every value in a list separated by spaces and tabs
+		template< typename Function >
+		void forEachSeparatedValue( std::string_view values, Function f ) {
+			for( size_t i = 0 ; i < values.size() ; ) {
+				if( values[ i ] == ' ' || values[ i ] == '\t' ) {
+					++i;
+					continue;
+				}
+
+				const size_t valueBegin = i;
+				while( i < values.size() && values[ i ] != ' ' && values[ i ] != '\t' ) {
+					++i;
+				}
+				f( values.substr( valueBegin, i - valueBegin ) );
+			}
+		}
+
+		// handlers with a numbers method receive number lists in one call (see Parser)
+		template< typename Handler, typename Enable = void >
+		struct HasNumbers : std::false_type {};
+
+		template< typename Handler >
+		struct HasNumbers< Handler, decltype( std::declval< Handler & >().numbers( std::string_view(), size_t(), std::declval< const TextIterator & >() ) ) > : std::true_type {};
+
+		// reads WML and reports its structure to a handler:
+		//
+		//	struct Handler {
+		//		// starts a new entry (inside the current one)
+		//		void beginEntry( std::string &&key, const TextIterator &position );
+		//		// adds an inline value or a text block to the current entry
+		//		void value( std::string &&value, const TextIterator &position );
+		//		// optional: adds count number values at once, straight from the source line
+		//		// (with ParseOptions::packedNumberLists, otherwise every number is passed to value)
+		//		void numbers( std::string_view values, size_t count, const TextIterator &position );
+		//		// ends the current entry (position is after its last line)
+		//		void endEntry( const TextIterator &position );
+		//	};
+		//
+		// the document itself is the outermost entry and has no events
+		// TextContext( position ) is the context the node gets in a Node tree
+		template< typename Handler >
 		struct Parser {
 			int indentLevel;
 			TextIterator textIterator;
+			Handler &handler;
+			ParseOptions options;
+
+			// see Stats
+			size_t escapedStrings;
+			size_t textBlocks;
 
 			std::string parseIdentifier() {
 				std::string text;
@@ -83,6 +153,7 @@ namespace wml {
 				if( !textIterator.tryMatch( '"' ) ) {
 					textIterator.error( "'\"' expected!" );
 				}
+				++escapedStrings;
 
 				while( textIterator.checkNotAny( "\"\n" ) ) {
 					if( textIterator.tryMatch( '\\' ) ) {
@@ -237,7 +308,9 @@ namespace wml {
 				}
 			}
 
-			void parseNode( Node &node, bool allowEmpty = true ) {
+			void parseNode( bool allowEmpty = true ) {
+				bool isEmpty = true;
+
 				while( true ) {
 					skipEmptyLines();
 
@@ -252,12 +325,15 @@ namespace wml {
 
 					std::string key = parseValue();
 
-					Node childNode( key, TextContext( textIterator ) );
+					handler.beginEntry( std::move( key ), textIterator );
+					isEmpty = false;
 
 					skipWhitespace();
 
 					if( textIterator.tryMatch( ':' ) ) {
 						if( textIterator.tryMatch( ':' ) ) {
+							WML_TRACE_RANGE_SCOPE_IF( true, "parseTextBlock", textIterator.current.line, textIterator.current.index );
+
 							// raw text
 							skipWhitespace();
 							expectNewline();
@@ -266,50 +342,341 @@ namespace wml {
 							std::string indentedText = parseIndentedText();
 							indentLevel--;
 
-							childNode.nodes.push_back( Node( indentedText, TextContext( textIterator ) ) );
+							++textBlocks;
+							handler.value( std::move( indentedText ), textIterator );
 						}
 						else {
+							WML_TRACE_RANGE_SCOPE_IF( indentLevel < WML_TRACE_DEPTH, "parseMap", textIterator.current.line, textIterator.current.index );
+
 							skipWhitespace();
 							expectNewline();
 
 							indentLevel++;
-							parseNode( childNode, false );
+							parseNode( false );
 							indentLevel--;
 						}
 					}
 					else {
-						parseInlineValues( childNode );
+						parseInlineValues();
 					}
 
-					node.nodes.push_back( std::move( childNode ) );
+					handler.endEntry( textIterator );
 				}
 
-				if( node.nodes.empty() && !allowEmpty ) {
+				if( isEmpty && !allowEmpty ) {
 					textIterator.error( "expected non-empty map" );
 				}
 			}
 
-			void parseInlineValues( Node &node ) {
+			// fast path for long lists of numbers: scans the raw line once
+			// all values are reported at the start of the line
+			// leaves the iterator untouched if the line doesn't qualify
+			bool tryParseNumbers() {
+				const std::string_view text = textIterator.textContainer.text;
+				const size_t begin = textIterator.current.index;
+
+				size_t end = begin;
+				size_t count = 0;
+				// start of the current value (or NONE between values)
+				const size_t NONE = size_t( -1 );
+				size_t valueBegin = NONE;
+				for( ; end <= text.size() ; ++end ) {
+					const char c = end < text.size() ? text[ end ] : '\n';
+					if( c == ' ' || c == '\t' || c == '\n' || c == '\r' ) {
+						// the characters alone allow "e", "-" or "+."
+						if( valueBegin != NONE && !isNumber( text.substr( valueBegin, end - valueBegin ) ) ) {
+							return false;
+						}
+						valueBegin = NONE;
+
+						if( c == '\n' || c == '\r' ) {
+							break;
+						}
+					}
+					else if( isNumberCharacter( c ) ) {
+						if( valueBegin == NONE ) {
+							++count;
+							valueBegin = end;
+						}
+					}
+					else {
+						return false;
+					}
+				}
+
+				// packing single values wouldn't save anything (see NodeBuilder::shouldPack)
+				// packed values use 32 bit offsets
+				if( count < std::max< size_t >( options.packedNumberLists, 2 ) || end - begin > UINT32_MAX ) {
+					return false;
+				}
+
+				const std::string_view values( text.data() + begin, end - begin );
+				if constexpr( HasNumbers< Handler >::value ) {
+					handler.numbers( values, count, textIterator );
+				}
+				else {
+					forEachSeparatedValue( values, [this] ( std::string_view value ) {
+						handler.value( std::string( value ), textIterator );
+					} );
+				}
+
+				// the line contains no newlines, so we can skip it directly
+				textIterator.current.column += int( end - begin );
+				textIterator.current.index = int( end );
+				if( !textIterator.isAtEnd() ) {
+					expectNewline();
+				}
+				return true;
+			}
+
+			void parseInlineValues() {
+				if( options.packedNumberLists && tryParseNumbers() ) {
+					return;
+				}
+
 				while( !textIterator.isAtEnd() && !textIterator.tryMatch( '\n' ) ) {
 					std::string value = parseValue();
 
-					node.nodes.push_back( Node( value, TextContext( textIterator ) ) );
+					handler.value( std::move( value ), textIterator );
 
 					skipWhitespace();
 				}
 			}
 
-			Parser( const TextContainer &textContainer ) : indentLevel( 0 ), textIterator( textContainer, TextPosition() ) {}
+			Parser( Handler &handler, const TextContainer &textContainer, const ParseOptions &options = ParseOptions() ) : indentLevel( 0 ), textIterator( textContainer, TextPosition() ), handler( handler ), options( options ), escapedStrings( 0 ), textBlocks( 0 ) {}
 		};
 
-		inline Node parse( const std::string &content, const std::string &sourceIdentifier ) {
-			TextContainer textContainer( content, sourceIdentifier );
+		inline bool isNumberCharacter( char c ) {
+			static const struct Table {
+				bool entries[ 256 ];
+
+				Table() : entries() {
+					for( const char *c = "0123456789+-.eE" ; *c ; ++c ) {
+						entries[ (unsigned char) *c ] = true;
+					}
+				}
+			} table;
+
+			return table.entries[ (unsigned char) c ];
+		}
+
+		// decimal numbers with an optional sign, fraction and exponent ("-1", "+.5", "2.", "1e-3")
+		inline bool isNumber( std::string_view text ) {
+			size_t i = 0;
+			const auto skipDigits = [&] () {
+				const size_t start = i;
+				while( i < text.size() && text[ i ] >= '0' && text[ i ] <= '9' ) {
+					++i;
+				}
+				return i - start;
+			};
+
+			if( i < text.size() && ( text[ i ] == '+' || text[ i ] == '-' ) ) {
+				++i;
+			}
+			size_t numDigits = skipDigits();
+			if( i < text.size() && text[ i ] == '.' ) {
+				++i;
+				numDigits += skipDigits();
+			}
+			if( numDigits == 0 ) {
+				return false;
+			}
 
-			Parser parser( textContainer );
+			if( i < text.size() && ( text[ i ] == 'e' || text[ i ] == 'E' ) ) {
+				++i;
+				if( i < text.size() && ( text[ i ] == '+' || text[ i ] == '-' ) ) {
+					++i;
+				}
+				if( skipDigits() == 0 ) {
+					return false;
+				}
+			}
+			return i == text.size();
+		}
+
+		// builds a tree of NodeTs from the parser events
+		//
+		// the children of the open entries are collected in reused per-level vectors and moved into
+		// a vector of the exact size when their entry ends, so nodes are moved once and child vectors
+		// have no unused capacity
+		template< typename NodeT >
+		struct NodeBuilder {
+			typedef typename NodeT::NodeContainer NodeContainer;
+			typedef typename NodeT::PackedValues PackedValues;
+
+			ParseOptions options;
+
+			NodeT &root;
+			// the open entries: path[ i ] is the position of the entry of depth i + 1 in children[ i ]
+			// (positions instead of pointers, so containers are free to move their elements)
+			std::vector< size_t > path;
+			// children[ i ] are the children that have been read so far of the root (i = 0) or of the entry path[ i - 1 ]
+			std::vector< NodeContainer > children;
+
+			// state of the innermost entry's value list (see ParseOptions)
+			std::shared_ptr< PackedValues > packed;
+
+			// see ParseOptions::trackSourceSpans
+			bool tracksSpans;
+
+			NodeContainer &currentChildren() {
+				return children[ path.size() ];
+			}
 
-			Node node( sourceIdentifier );
-			parser.parseNode( node );
+			NodeT &innermostEntry() {
+				return path.empty() ? root : children[ path.size() - 1 ][ path.back() ];
+			}
+
+			// nodes that don't keep their context don't need the surrounding text either
+			static typename NodeT::Context makeContext( const TextIterator &position ) {
+				if constexpr( NodeT::keepsContext ) {
+					return TextContext( position );
+				}
+				else {
+					return typename NodeT::Context();
+				}
+			}
+
+			static NodeT makeNode( std::string &&text, const TextIterator &position ) {
+				return NodeT( makeString< typename NodeT::String >( std::move( text ) ), makeContext( position ) );
+			}
+
+			void beginEntry( std::string &&key, const TextIterator &position ) {
+				NodeContainer &siblings = currentChildren();
+
+				siblings.push_back( makeNode( std::move( key ), position ) );
+				path.push_back( siblings.size() - 1 );
+				if( children.size() <= path.size() ) {
+					children.resize( path.size() + 1 );
+				}
+
+				if( tracksSpans ) {
+					NodeT &entry = innermostEntry();
+
+					// the entry starts at the beginning of the line
+					const std::string_view text = position.textContainer.text;
+					size_t lineStart = position.current.index;
+					while( lineStart > 0 && text[ lineStart - 1 ] != '\n' && text[ lineStart - 1 ] != '\r' ) {
+						--lineStart;
+					}
+					entry.span.begin = uint32_t( lineStart );
+					entry.span.contentHash = SourceSpan::hash( entry.content );
+				}
+
+				packed.reset();
+			}
+
+			void value( std::string &&value, const TextIterator &position ) {
+				if( packed ) {
+					packed->push_back( value );
+					return;
+				}
+
+				NodeContainer &values = currentChildren();
+				values.push_back( makeNode( std::move( value ), position ) );
+				if( tracksSpans ) {
+					// values are covered by the span of their entry
+					values.back().span.begin = values.back().span.end = uint32_t( position.current.index );
+					values.back().span.contentHash = SourceSpan::hash( values.back().content );
+				}
+
+				if( shouldPack( values.size() ) ) {
+					packed = std::make_shared< PackedValues >();
+					packed->context = values[0].context;
+					for( auto item = values.cbegin() ; item != values.cend() ; ++item ) {
+						packed->push_back( item->content );
+					}
+					values.clear();
+				}
+			}
+
+			// number lists are packed straight from the source line (see Parser::tryParseNumbers)
+			void numbers( std::string_view values, size_t count, const TextIterator &position ) {
+				packed = std::make_shared< PackedValues >();
+				packed->context = makeContext( position );
+				packed->text.reserve( values.size() );
+				packed->offsets.reserve( count + 1 );
+
+				forEachSeparatedValue( values, [this] ( std::string_view value ) {
+					packed->push_back( value );
+				} );
+			}
+
+			// moves the collected children into node
+			void takeChildren( NodeT &node ) {
+				NodeContainer &collected = currentChildren();
+				if( !collected.empty() ) {
+					NodeContainer( std::make_move_iterator( collected.begin() ), std::make_move_iterator( collected.end() ) ).swap( node.nodes );
+					collected.clear();
+				}
+			}
+
+			void endEntry( const TextIterator &position ) {
+				NodeT &node = innermostEntry();
+				if( packed ) {
+					node.packed = std::move( packed );
+				}
+				takeChildren( node );
+
+				if( tracksSpans ) {
+					node.span.end = uint32_t( position.current.index );
+					node.span.numChildren = uint32_t( node.size() );
+				}
+				path.pop_back();
+			}
+
+			// moves the entries into the root
+			void finish() {
+				takeChildren( root );
+			}
+
+			bool shouldPack( size_t count ) const {
+				// packing single values wouldn't save anything
+				if( count < 2 ) {
+					return false;
+				}
+				return count == options.packedValueLists;
+			}
+
+			// spans are 32 bit, so sources of sourceSize >= 4 GiB aren't tracked
+			NodeBuilder( NodeT &root, const ParseOptions &options, size_t sourceSize )
+				: options( options ), root( root ), children( 1 ), tracksSpans( options.trackSourceSpans && sourceSize < SourceSpan::NONE ) {}
+		};
+
+		template< typename NodeT = Node >
+		NodeT parse( std::string_view content, const std::string &sourceIdentifier, const ParseOptions &options = ParseOptions(), Stats *stats = nullptr ) {
+			WML_TRACE_SIZED_SCOPE( "parse", 0, content.size() );
+
+			NodeT node( makeString< typename NodeT::String >( std::string_view( sourceIdentifier ) ) );
+			{
+				StatsScope scope( stats, &Stats::parseTime );
+
+				TextContainer textContainer( content, sourceIdentifier );
+				NodeBuilder< NodeT > builder( node, options, content.size() );
+
+				Parser< NodeBuilder< NodeT > > parser( builder, textContainer, options );
+				parser.parseNode();
+				builder.finish();
+
+				if( stats ) {
+					stats->escapedStrings += parser.escapedStrings;
+					stats->textBlocks += parser.textBlocks;
+				}
+
+				if( builder.tracksSpans ) {
+					node.span.begin = 0;
+					node.span.end = uint32_t( content.size() );
+					node.span.numChildren = uint32_t( node.size() );
+					node.span.contentHash = SourceSpan::hash( node.content );
+				}
+			}
+
+			if( stats ) {
+				stats->bytes += content.size();
+				measureTree( node, 0, *stats );
+			}
 			return node;
 		}
 	}
-}
\ No newline at end of file
+}
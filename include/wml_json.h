@@ -0,0 +1,562 @@
+/*
+Copyright 2013 Andreas Kirsch
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include "wml.h"
+
+#include <streambuf>
+
+// conversion between WML and JSON without building trees
+//
+// mapping (WML -> JSON):
+//	the document and every map ('key:')	object
+//	repeated keys						repeated members in the same order
+//	'key value'							"key": "value"
+//	'key a b c'							"key": [ "a", "b", "c" ]
+//	'key::' text block					"key": "text"
+//	'key' (no values)					"key": null
+// all values are strings
+//
+// mapping (JSON -> WML):
+//	the outermost value must be an object
+//	objects								maps (empty objects become entries without values)
+//	strings, numbers, true, false		values (numbers and booleans keep their text)
+//	null								entries without values
+//	arrays								consecutive scalars form one value list entry,
+//										objects and nested arrays become repeated entries with the same key
+//										(empty arrays become entries without values)
+//
+// WML -> JSON -> WML keeps the document (text blocks become quoted strings like with emit)
+
+namespace wml {
+	namespace detail {
+		// escape character for every character that needs one in JSON strings ('u' for \u00XX)
+		inline const char *jsonEscapeCharacters() {
+			static const struct Table {
+				char entries[ 256 ];
+
+				Table() : entries() {
+					for( int c = 0 ; c < 0x20 ; ++c ) {
+						entries[ c ] = 'u';
+					}
+					entries[ (unsigned char) '\n' ] = 'n';
+					entries[ (unsigned char) '\r' ] = 'r';
+					entries[ (unsigned char) '\t' ] = 't';
+					entries[ (unsigned char) '\b' ] = 'b';
+					entries[ (unsigned char) '\f' ] = 'f';
+					entries[ (unsigned char) '"' ] = '"';
+					entries[ (unsigned char) '\\' ] = '\\';
+				}
+			} table;
+
+			return table.entries;
+		}
+
+		// Parser handler that writes JSON
+		// only the innermost entry is kept until it is clear whether it is a map, a value or a list
+		template< typename Output >
+		struct JsonWriter {
+			Output &output;
+
+			// per open object: true until its first member has been written
+			std::vector< bool > isFirstMember;
+
+			// the innermost entry if it hasn't been written yet
+			bool isEntryPending;
+			std::string key;
+			// its first value and the number of values
+			std::string firstValue;
+			size_t numValues;
+
+			void writeString( std::string_view text ) {
+				static const char *hex = "0123456789abcdef";
+				const char *escapes = jsonEscapeCharacters();
+
+				output.push_back( '"' );
+
+				const char *run = text.data();
+				const char *end = text.data() + text.size();
+				for( const char *c = run ; c != end ; ++c ) {
+					const char escape = escapes[ (unsigned char) *c ];
+					if( escape ) {
+						output.append( run, c - run );
+						if( escape == 'u' ) {
+							const char escaped[] = { '\\', 'u', '0', '0', hex[ *c >> 4 ], hex[ *c & 15 ] };
+							output.append( escaped, 6 );
+						}
+						else {
+							const char escaped[] = { '\\', escape };
+							output.append( escaped, 2 );
+						}
+						run = c + 1;
+					}
+				}
+				output.append( run, end - run );
+
+				output.push_back( '"' );
+			}
+
+			void writeMemberName() {
+				if( !isFirstMember.back() ) {
+					output.push_back( ',' );
+				}
+				isFirstMember.back() = false;
+
+				writeString( key );
+				output.push_back( ':' );
+			}
+
+			void beginObject() {
+				output.push_back( '{' );
+				isFirstMember.push_back( true );
+			}
+
+			void endObject() {
+				output.push_back( '}' );
+				isFirstMember.pop_back();
+			}
+
+			void beginEntry( std::string &&newKey, const LeanTextProcessing::TextIterator & ) {
+				// the parent has children, so it is a map
+				if( isEntryPending ) {
+					writeMemberName();
+					beginObject();
+				}
+
+				key = std::move( newKey );
+				isEntryPending = true;
+				numValues = 0;
+			}
+
+			void value( std::string &&value, const LeanTextProcessing::TextIterator & ) {
+				if( numValues == 0 ) {
+					firstValue = std::move( value );
+				}
+				else {
+					if( numValues == 1 ) {
+						writeMemberName();
+						output.push_back( '[' );
+						writeString( firstValue );
+					}
+					output.push_back( ',' );
+					writeString( value );
+				}
+				++numValues;
+			}
+
+			void endEntry( const LeanTextProcessing::TextIterator & ) {
+				if( !isEntryPending ) {
+					endObject();
+					return;
+				}
+
+				if( numValues == 0 ) {
+					writeMemberName();
+					output.append( "null", 4 );
+				}
+				else if( numValues == 1 ) {
+					writeMemberName();
+					writeString( firstValue );
+				}
+				else {
+					output.push_back( ']' );
+				}
+				isEntryPending = false;
+			}
+
+			explicit JsonWriter( Output &output ) : output( output ), isEntryPending( false ), numValues( 0 ) {
+				beginObject();
+			}
+		};
+
+		// reads JSON from a stream buffer and writes WML
+		// memory use only depends on the nesting depth and the length of single strings
+		template< typename Output >
+		struct JsonReader {
+			std::streambuf &input;
+			Output &output;
+			Emitter< Output > emitter;
+
+			LeanTextProcessing::TextContext context;
+
+			int peek() {
+				return input.sgetc();
+			}
+
+			int read() {
+				const int c = input.sbumpc();
+				if( c != std::char_traits< char >::eof() ) {
+					++context.position.index;
+					++context.position.column;
+					if( c == '\n' ) {
+						++context.position.line;
+						context.position.column = 1;
+					}
+				}
+				return c;
+			}
+
+			void error( const std::string &message ) const {
+				throw LeanTextProcessing::TextException( context, message );
+			}
+
+			void skipWhitespace() {
+				for( int c = peek() ; c == ' ' || c == '\t' || c == '\n' || c == '\r' ; c = peek() ) {
+					read();
+				}
+			}
+
+			bool tryMatch( char expected ) {
+				skipWhitespace();
+				if( peek() == expected ) {
+					read();
+					return true;
+				}
+				return false;
+			}
+
+			void expect( char expected ) {
+				if( !tryMatch( expected ) ) {
+					error( boost::str( boost::format( "'%c' expected!" ) % expected ) );
+				}
+			}
+
+			void appendUtf8( std::string &text, unsigned code ) {
+				if( code < 0x80 ) {
+					text.push_back( char( code ) );
+				}
+				else if( code < 0x800 ) {
+					text.push_back( char( 0xC0 | ( code >> 6 ) ) );
+					text.push_back( char( 0x80 | ( code & 0x3F ) ) );
+				}
+				else if( code < 0x10000 ) {
+					text.push_back( char( 0xE0 | ( code >> 12 ) ) );
+					text.push_back( char( 0x80 | ( ( code >> 6 ) & 0x3F ) ) );
+					text.push_back( char( 0x80 | ( code & 0x3F ) ) );
+				}
+				else {
+					text.push_back( char( 0xF0 | ( code >> 18 ) ) );
+					text.push_back( char( 0x80 | ( ( code >> 12 ) & 0x3F ) ) );
+					text.push_back( char( 0x80 | ( ( code >> 6 ) & 0x3F ) ) );
+					text.push_back( char( 0x80 | ( code & 0x3F ) ) );
+				}
+			}
+
+			unsigned readHex() {
+				unsigned code = 0;
+				for( int i = 0 ; i < 4 ; ++i ) {
+					const int c = read();
+					if( c >= '0' && c <= '9' ) {
+						code = code * 16 + ( c - '0' );
+					}
+					else if( c >= 'a' && c <= 'f' ) {
+						code = code * 16 + ( c - 'a' + 10 );
+					}
+					else if( c >= 'A' && c <= 'F' ) {
+						code = code * 16 + ( c - 'A' + 10 );
+					}
+					else {
+						error( "expected 4 hex digits!" );
+					}
+				}
+				return code;
+			}
+
+			// reads a string (after the opening quote)
+			void readString( std::string &text ) {
+				text.clear();
+				while( true ) {
+					const int c = read();
+					if( c == std::char_traits< char >::eof() ) {
+						error( "unexpected EOF!" );
+					}
+					if( c == '"' ) {
+						return;
+					}
+					if( c != '\\' ) {
+						text.push_back( char( c ) );
+						continue;
+					}
+
+					const int control = read();
+					switch( control ) {
+					case '"':
+					case '\\':
+					case '/':
+						text.push_back( char( control ) );
+						break;
+					case 'n':
+						text.push_back( '\n' );
+						break;
+					case 'r':
+						text.push_back( '\r' );
+						break;
+					case 't':
+						text.push_back( '\t' );
+						break;
+					case 'b':
+						text.push_back( '\b' );
+						break;
+					case 'f':
+						text.push_back( '\f' );
+						break;
+					case 'u': {
+						unsigned code = readHex();
+						// UTF-8 can't encode lone surrogates
+						if( code >= 0xDC00 && code < 0xE000 ) {
+							error( "unexpected low surrogate!" );
+						}
+						// surrogate pair
+						if( code >= 0xD800 && code < 0xDC00 ) {
+							if( read() != '\\' || read() != 'u' ) {
+								error( "expected low surrogate!" );
+							}
+							const unsigned low = readHex();
+							if( low < 0xDC00 || low >= 0xE000 ) {
+								error( "expected low surrogate!" );
+							}
+							code = 0x10000 + ( ( code - 0xD800 ) << 10 ) + ( low - 0xDC00 );
+						}
+						appendUtf8( text, code );
+						break;
+					}
+					default:
+						error( boost::str( boost::format( "unknown escape control character '%c'!" ) % char( control ) ) );
+					}
+				}
+			}
+
+			static bool isDigit( std::string::const_iterator c, std::string::const_iterator end ) {
+				return c != end && *c >= '0' && *c <= '9';
+			}
+
+			// -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+			static bool isNumber( const std::string &text ) {
+				auto c = text.cbegin();
+				const auto end = text.cend();
+				if( c != end && *c == '-' ) {
+					++c;
+				}
+				if( !isDigit( c, end ) ) {
+					return false;
+				}
+				if( *c++ != '0' ) {
+					while( isDigit( c, end ) ) {
+						++c;
+					}
+				}
+				if( c != end && *c == '.' ) {
+					if( !isDigit( ++c, end ) ) {
+						return false;
+					}
+					while( isDigit( c, end ) ) {
+						++c;
+					}
+				}
+				if( c != end && ( *c == 'e' || *c == 'E' ) ) {
+					++c;
+					if( c != end && ( *c == '+' || *c == '-' ) ) {
+						++c;
+					}
+					if( !isDigit( c, end ) ) {
+						return false;
+					}
+					while( isDigit( c, end ) ) {
+						++c;
+					}
+				}
+				return c == end;
+			}
+
+			// reads a string, number, true, false or null
+			// returns false for null
+			bool readScalar( std::string &text ) {
+				skipWhitespace();
+				if( peek() == '"' ) {
+					read();
+					readString( text );
+					return true;
+				}
+
+				text.clear();
+				for( int c = peek() ; ( c >= '0' && c <= '9' ) || ( c >= 'a' && c <= 'z' ) || c == '-' || c == '+' || c == '.' || c == 'E' ; c = peek() ) {
+					text.push_back( char( read() ) );
+				}
+
+				if( text.empty() ) {
+					error( "expected value!" );
+				}
+				if( text == "null" ) {
+					return false;
+				}
+				if( text != "true" && text != "false" && !isNumber( text ) ) {
+					error( boost::str( boost::format( "unexpected '%s'!" ) % text ) );
+				}
+				return true;
+			}
+
+			void beginLine( const std::string &key, int indentLevel ) {
+				emitter.indentLevel = indentLevel;
+				emitter.emitTabs();
+				emitter.emitValue( key, true );
+			}
+
+			void writeEmptyEntry( const std::string &key, int indentLevel ) {
+				beginLine( key, indentLevel );
+				output.push_back( '\n' );
+			}
+
+			// reads the members of an object (after '{') as the entries of a map
+			// the map header is written before the first member (see readValue)
+			void readMembers( const std::string *mapKey, int indentLevel ) {
+				if( tryMatch( '}' ) ) {
+					if( mapKey ) {
+						writeEmptyEntry( *mapKey, indentLevel - 1 );
+					}
+					return;
+				}
+
+				if( mapKey ) {
+					emitter.indentLevel = indentLevel - 1;
+					emitter.emitMapHeader( *mapKey );
+				}
+
+				std::string key;
+				do {
+					expect( '"' );
+					readString( key );
+					expect( ':' );
+					readValue( key, indentLevel );
+				} while( tryMatch( ',' ) );
+
+				expect( '}' );
+			}
+
+			void readArray( const std::string &key, int indentLevel ) {
+				if( tryMatch( ']' ) ) {
+					writeEmptyEntry( key, indentLevel );
+					return;
+				}
+
+				std::string value;
+				bool isListOpen = false;
+				do {
+					skipWhitespace();
+					if( peek() == '{' || peek() == '[' ) {
+						if( isListOpen ) {
+							output.push_back( '\n' );
+							isListOpen = false;
+						}
+						readValue( key, indentLevel );
+					}
+					else if( readScalar( value ) ) {
+						if( !isListOpen ) {
+							beginLine( key, indentLevel );
+							isListOpen = true;
+						}
+						output.push_back( ' ' );
+						emitter.emitValue( value, true );
+					}
+					else {
+						// null ends the list
+						if( isListOpen ) {
+							output.push_back( '\n' );
+							isListOpen = false;
+						}
+						writeEmptyEntry( key, indentLevel );
+					}
+				} while( tryMatch( ',' ) );
+
+				if( isListOpen ) {
+					output.push_back( '\n' );
+				}
+				expect( ']' );
+			}
+
+			void readValue( const std::string &key, int indentLevel ) {
+				std::string value;
+				if( tryMatch( '{' ) ) {
+					readMembers( &key, indentLevel + 1 );
+				}
+				else if( tryMatch( '[' ) ) {
+					readArray( key, indentLevel );
+				}
+				else if( readScalar( value ) ) {
+					beginLine( key, indentLevel );
+					output.push_back( ' ' );
+					emitter.emitValue( value, true );
+					output.push_back( '\n' );
+				}
+				else {
+					writeEmptyEntry( key, indentLevel );
+				}
+			}
+
+			void readDocument() {
+				expect( '{' );
+				readMembers( nullptr, 0 );
+
+				skipWhitespace();
+				if( peek() != std::char_traits< char >::eof() ) {
+					error( "expected end of input!" );
+				}
+			}
+
+			JsonReader( std::streambuf &input, Output &output, const std::string &sourceIdentifier ) : input( input ), output( output ), emitter( output ) {
+				context.name = sourceIdentifier;
+			}
+		};
+	}
+
+	// writes the WML document as JSON (see the mapping above)
+	// content is read in place (the parser needs the whole text, but doesn't copy it)
+	inline void wmlToJson( std::string_view content, const std::function< void ( const char *data, size_t size ) > &write, const std::string &sourceIdentifier = "", size_t bufferSize = 64 * 1024 ) {
+		LeanTextProcessing::TextContainer textContainer( content, sourceIdentifier );
+
+		detail::BufferedOutput output( write, bufferSize );
+		detail::JsonWriter< detail::BufferedOutput > writer( output );
+		detail::Parser< detail::JsonWriter< detail::BufferedOutput > > parser( writer, textContainer );
+		parser.parseNode();
+		writer.endObject();
+		output.push_back( '\n' );
+
+		output.flush();
+	}
+
+	inline void wmlToJson( std::string_view content, std::ostream &stream, const std::string &sourceIdentifier = "" ) {
+		wmlToJson( content, [&stream] ( const char *data, size_t size ) { stream.write( data, size ); }, sourceIdentifier );
+	}
+
+	// reads a JSON document from input and writes it as WML (see the mapping above)
+	inline void jsonToWml( std::istream &input, const std::function< void ( const char *data, size_t size ) > &write, const std::string &sourceIdentifier = "", size_t bufferSize = 64 * 1024 ) {
+		detail::BufferedOutput output( write, bufferSize );
+		detail::JsonReader< detail::BufferedOutput > reader( *input.rdbuf(), output, sourceIdentifier );
+		reader.readDocument();
+
+		output.flush();
+	}
+
+	inline void jsonToWml( std::istream &input, std::ostream &stream, const std::string &sourceIdentifier = "" ) {
+		jsonToWml( input, [&stream] ( const char *data, size_t size ) { stream.write( data, size ); }, sourceIdentifier );
+	}
+}
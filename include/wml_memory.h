@@ -0,0 +1,189 @@
+/*
+Copyright 2013 Andreas Kirsch
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include "wml.h"
+
+namespace wml {
+	// heap memory used by a tree in bytes (see memoryUsage)
+	struct MemoryUsage {
+		size_t nodes;
+
+		// the Node structs themselves (sizeof( Node ) for every node but the root)
+		size_t nodeBytes;
+		// unused capacity of the child vectors
+		size_t childSlackBytes;
+		// keys and values (strings that fit into their small string buffer are free)
+		size_t contentBytes;
+		// source names and surrounding text of the contexts
+		size_t contextBytes;
+		// packed value lists including their unpacked children (buffers shared by copies are counted for every copy)
+		size_t packedBytes;
+		// key indices of big nodes
+		size_t indexBytes;
+
+		size_t total() const {
+			return nodeBytes + childSlackBytes + contentBytes + contextBytes + packedBytes + indexBytes;
+		}
+
+		MemoryUsage() : nodes( 0 ), nodeBytes( 0 ), childSlackBytes( 0 ), contentBytes( 0 ), contextBytes( 0 ), packedBytes( 0 ), indexBytes( 0 ) {}
+	};
+
+	struct CompactOptions {
+		// replace all contexts with empty ones (errors won't report the source position anymore)
+		bool dropContexts;
+		// store lists of at least 2 leaf values in one buffer (see Node::packed)
+		// the values share the context of the first one, so errors about later values report the wrong position
+		bool packValueLists;
+
+		CompactOptions() : dropContexts( false ), packValueLists( false ) {}
+	};
+
+	namespace detail {
+		inline size_t heapSize( const std::string &text ) {
+			const char *object = reinterpret_cast< const char * >( &text );
+			// small strings are stored inside the object
+			if( text.data() >= object && text.data() < object + sizeof( text ) ) {
+				return 0;
+			}
+			return text.capacity() + 1;
+		}
+
+		inline size_t heapSize( const LeanTextProcessing::TextContext &context ) {
+			return heapSize( context.name ) + heapSize( context.surroundingText );
+		}
+
+		inline void addMemoryUsage( const Node &node, MemoryUsage &usage ) {
+			usage.contentBytes += heapSize( node.content );
+			usage.contextBytes += heapSize( node.context );
+			usage.nodeBytes += node.nodes.size() * sizeof( Node );
+			usage.childSlackBytes += ( node.nodes.capacity() - node.nodes.size() ) * sizeof( Node );
+			usage.nodes += node.size();
+
+			if( node.packed ) {
+				usage.packedBytes += sizeof( PackedValues ) + heapSize( node.packed->text ) + node.packed->offsets.capacity() * sizeof( uint32_t );
+				usage.contextBytes += heapSize( node.packed->context );
+
+				// children created for code that needs them
+				const Node::NodeContainer *unpacked = node.packed->unpackedNodes.load( std::memory_order_acquire );
+				if( unpacked ) {
+					usage.packedBytes += sizeof( Node::NodeContainer ) + unpacked->capacity() * sizeof( Node );
+					for( auto child = unpacked->cbegin() ; child != unpacked->cend() ; ++child ) {
+						usage.packedBytes += heapSize( child->content ) + heapSize( child->context );
+					}
+				}
+			}
+
+			const KeyIndex *index = node.keyIndex.index.load( std::memory_order_acquire );
+			if( index ) {
+				usage.indexBytes += sizeof( KeyIndex ) + index->buckets.capacity() * sizeof( KeyIndex::Bucket ) + ( index->next.capacity() + index->hashes.capacity() ) * sizeof( size_t );
+			}
+
+			for( auto child = node.nodes.cbegin() ; child != node.nodes.cend() ; ++child ) {
+				addMemoryUsage( *child, usage );
+			}
+		}
+
+		inline bool isValueList( const Node &node ) {
+			if( node.packed || node.nodes.size() < 2 ) {
+				return false;
+			}
+			for( auto child = node.nodes.cbegin() ; child != node.nodes.cend() ; ++child ) {
+				if( !child->empty() ) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		inline void packValues( Node &node, const CompactOptions &options ) {
+			size_t textSize = 0;
+			for( auto child = node.nodes.cbegin() ; child != node.nodes.cend() ; ++child ) {
+				textSize += child->content.size();
+			}
+
+			std::shared_ptr< PackedValues > packed = std::make_shared< PackedValues >();
+			packed->text.reserve( textSize );
+			packed->offsets.reserve( node.nodes.size() + 1 );
+			if( !options.dropContexts ) {
+				packed->context = node.nodes[0].context;
+			}
+			for( auto child = node.nodes.cbegin() ; child != node.nodes.cend() ; ++child ) {
+				packed->push_back( child->content );
+				// keep changes visible to emitPreserving
+				if( !child->span.isUnchanged( child->content ) ) {
+					node.markModified();
+				}
+			}
+
+			Node::NodeContainer().swap( node.nodes );
+			node.packed = std::move( packed );
+		}
+
+		// works top-down, so the allocations of a subtree are made one after another
+		inline void compact( Node &node, const CompactOptions &options, bool isTopLevel ) {
+			node.content.shrink_to_fit();
+			if( options.dropContexts ) {
+				// swap to really free the memory (assigning an empty string keeps the capacity)
+				std::string().swap( node.context.name );
+				std::string().swap( node.context.surroundingText );
+				node.context.position = LeanTextProcessing::TextPosition();
+			}
+			else {
+				node.context.name.shrink_to_fit();
+				node.context.surroundingText.shrink_to_fit();
+			}
+
+			// the index refers to the old storage
+			node.keyIndex.reset();
+
+			if( !isTopLevel && options.packValueLists && isValueList( node ) ) {
+				packValues( node, options );
+				return;
+			}
+
+			// reallocate with the exact size
+			if( node.nodes.capacity() != node.nodes.size() ) {
+				Node::NodeContainer( std::make_move_iterator( node.nodes.begin() ), std::make_move_iterator( node.nodes.end() ) ).swap( node.nodes );
+			}
+
+			for( auto child = node.nodes.begin() ; child != node.nodes.end() ; ++child ) {
+				compact( *child, options, false );
+			}
+		}
+	}
+
+	// heap memory used by the tree below node
+	inline MemoryUsage memoryUsage( const Node &node ) {
+		MemoryUsage usage;
+		detail::addMemoryUsage( node, usage );
+		return usage;
+	}
+
+	// frees unused capacity of all strings and child vectors (and optionally contexts and
+	// value lists, see CompactOptions)
+	// keys, values and emitted text stay the same
+	inline void compact( Node &node, const CompactOptions &options = CompactOptions() ) {
+		detail::compact( node, options, true );
+	}
+}
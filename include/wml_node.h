@@ -24,213 +24,1050 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include <vector>
 #include <string>
+#include <string_view>
+#include <optional>
 #include <boost/lexical_cast.hpp>
 #include <utility>
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <cstdint>
+#if __has_include( <version> )
+#	include <version>
+#endif
+#ifdef __cpp_lib_ranges
+#	include <ranges>
+#endif
+#ifdef __cpp_lib_span
+#	include <span>
+#endif
+#ifdef __cpp_lib_memory_resource
+#	include <memory_resource>
+#endif
 
 #include "leanTextProcessing.h"
+#include "wml_converter.h"
 
 namespace wml {
-	struct Node {
-		typedef std::vector< Node > NodeContainer;
-		typedef NodeContainer::iterator iterator;
-		typedef NodeContainer::const_iterator const_iterator;
+	template< typename Traits >
+	struct BasicNode;
+
+	// storage of the nodes of a tree (see BasicNode)
+	//
+	// String is the type of keys and values: it has to own its characters, be constructible from
+	// ( const char *, size_t ) and convert to std::string_view (std::string, std::pmr::string, ...)
+	// Container< NodeT > holds the children: a contiguous sequence with the interface of std::vector
+	// (std::vector, std::pmr::vector, boost::container::vector with another allocator, ...)
+	// nodes that don't keep their context have no source positions (errors are reported without one)
+	struct DefaultNodeTraits {
+		typedef std::string String;
+
+		template< typename NodeT >
+		using Container = std::vector< NodeT >;
+
+		static const bool keepsContext = true;
+	};
+
+	// nodes without a context: saves the source name, position and surrounding text of every node
+	struct CompactNodeTraits : DefaultNodeTraits {
+		static const bool keepsContext = false;
+	};
+
+#ifdef __cpp_lib_memory_resource
+	// allocates keys, values and children from std::pmr::get_default_resource()
+	// (as it is when the node is created)
+	struct PmrNodeTraits {
+		typedef std::pmr::string String;
+
+		template< typename NodeT >
+		using Container = std::pmr::vector< NodeT >;
+
+		static const bool keepsContext = true;
+	};
+#endif
+
+	namespace detail {
+		// context of nodes that don't keep it (see DefaultNodeTraits)
+		struct NoContext {
+			NoContext() {}
+			NoContext( const LeanTextProcessing::TextContext & ) {}
+		};
+
+		inline const LeanTextProcessing::TextContext &textContext( const LeanTextProcessing::TextContext &context ) {
+			return context;
+		}
+
+		inline const LeanTextProcessing::TextContext &textContext( const NoContext & ) {
+			static const LeanTextProcessing::TextContext none;
+			return none;
+		}
+
+		// converts text into the string type of a node (moves std::strings)
+		template< typename String >
+		String makeString( std::string &&text ) {
+			if constexpr( std::is_same< String, std::string >::value ) {
+				return std::move( text );
+			}
+			else {
+				return String( text.data(), text.size() );
+			}
+		}
+
+		template< typename String >
+		String makeString( std::string_view text ) {
+			return String( text.data(), text.size() );
+		}
+
+		// Converter< T >::format for other string types
+		template< typename T >
+		void formatInto( const T &value, std::string &text ) {
+			Converter< T >::format( value, text );
+		}
+
+		template< typename T, typename String >
+		void formatInto( const T &value, String &text ) {
+			std::string formatted;
+			Converter< T >::format( value, formatted );
+			text = makeString< String >( std::move( formatted ) );
+		}
+
+		// generation of all keys: changed whenever keys might be written through references
+		// odd values mean that an index has checked its keys since the last change, so only the first
+		// change after a lookup writes to the shared counter
+		inline std::atomic< size_t > &keyGeneration() {
+			static std::atomic< size_t > generation( 0 );
+			return generation;
+		}
+
+		// called by everything that hands out keys for writing (Node::key() and assignments of nodes)
+		inline void keysChanged() {
+			std::atomic< size_t > &generation = keyGeneration();
+			size_t current = generation.load( std::memory_order_relaxed );
+			if( current & 1 ) {
+				generation.compare_exchange_strong( current, current + 1, std::memory_order_relaxed );
+			}
+		}
+
+		// returns the current (odd) generation for an index that checks its keys
+		inline size_t observeKeyGeneration() {
+			std::atomic< size_t > &generation = keyGeneration();
+			size_t current = generation.load( std::memory_order_relaxed );
+			while( !( current & 1 ) && !generation.compare_exchange_weak( current, current + 1, std::memory_order_relaxed ) ) {
+			}
+			return current | 1;
+		}
+
+		// hash index over the keys of a node's children
+		// maps each key to the position of its first occurrence and chains duplicate keys
+		struct KeyIndex {
+			// nodes with fewer children are searched linearly
+			static const size_t minimumSize = 16;
+			// end of a chain in next (constexpr, so push_back can take it by reference)
+			static constexpr size_t NONE = size_t( -1 );
+
+			struct Bucket {
+				size_t hash;
+				// position of the first child with this key + 1 (0 for empty buckets)
+				size_t first;
+				// position of the last child with this key
+				size_t last;
+			};
+
+			// the children the index has been built for
+			const void *data;
+			size_t size;
+			// key generation at which the keys have been checked last
+			mutable std::atomic< size_t > generation;
+
+			std::vector< Bucket > buckets;
+			// position of the next child with the same key (or NONE)
+			std::vector< size_t > next;
+			// hash of the key of every child (to check the keys after keysChanged)
+			std::vector< size_t > hashes;
+
+			// indices that have been replaced while other threads might still have been using them
+			std::unique_ptr< const KeyIndex > retired;
+
+			static size_t hash( std::string_view key ) {
+				return std::hash< std::string_view >()( key );
+			}
+
+			// checking the last key catches a child that has been replaced at the end (erase + push_back)
+			template< typename NodeContainer >
+			bool isValidFor( const NodeContainer &nodes ) const {
+				return data == nodes.data() && size == nodes.size() && ( size == 0 || hashes.back() == hash( nodes[ size - 1 ].content ) );
+			}
+
+			// true if no key has been changed since the index has been built
+			template< typename NodeContainer >
+			bool matches( const NodeContainer &nodes ) const {
+				for( size_t position = 0 ; position < size ; ++position ) {
+					if( hashes[ position ] != hash( nodes[ position ].content ) ) {
+						return false;
+					}
+				}
+				return true;
+			}
+
+			// adds the child at position next.size()
+			template< typename NodeContainer >
+			void add( const NodeContainer &nodes ) {
+				const size_t position = next.size();
+				const std::string_view key = nodes[ position ].content;
+				const size_t keyHash = hash( key );
+				hashes.push_back( keyHash );
+				next.push_back( NONE );
+
+				const size_t mask = buckets.size() - 1;
+				size_t bucket = keyHash & mask;
+				for( ; buckets[ bucket ].first ; bucket = (bucket + 1) & mask ) {
+					if( buckets[ bucket ].hash == keyHash && nodes[ buckets[ bucket ].first - 1 ].content == key ) {
+						next[ buckets[ bucket ].last ] = position;
+						buckets[ bucket ].last = position;
+						return;
+					}
+				}
+
+				buckets[ bucket ].hash = keyHash;
+				buckets[ bucket ].first = position + 1;
+				buckets[ bucket ].last = position;
+			}
+
+			// adds the last child of nodes, returns false if the index has to be rebuilt instead
+			template< typename NodeContainer >
+			bool append( const NodeContainer &nodes ) {
+				// keep the load factor at most 1/2
+				if( 2 * nodes.size() > buckets.size() ) {
+					return false;
+				}
+				add( nodes );
+				data = nodes.data();
+				size = nodes.size();
+				return true;
+			}
+
+			template< typename NodeContainer >
+			KeyIndex( const NodeContainer &nodes, size_t generation ) : data( nodes.data() ), size( nodes.size() ), generation( generation ) {
+				size_t numBuckets = 1;
+				while( numBuckets < 2 * size ) {
+					numBuckets *= 2;
+				}
+
+				const Bucket emptyBucket = { 0, 0, 0 };
+				buckets.resize( numBuckets, emptyBucket );
+				next.reserve( size );
+				hashes.reserve( size );
+
+				for( size_t position = 0 ; position < size ; ++position ) {
+					add( nodes );
+				}
+			}
+
+			// returned by findFirst if the children don't match the index anymore
+			static const size_t STALE = size_t( -1 );
+
+			// returns size if the key isn't found
+			template< typename NodeContainer >
+			size_t findFirst( const NodeContainer &nodes, std::string_view key ) const {
+				const size_t keyHash = hash( key );
+				const size_t mask = buckets.size() - 1;
+
+				for( size_t bucket = keyHash & mask ; buckets[ bucket ].first ; bucket = (bucket + 1) & mask ) {
+					if( buckets[ bucket ].hash == keyHash ) {
+						// verify the hit: content might have been written directly
+						if( nodes[ buckets[ bucket ].first - 1 ].content != key ) {
+							return STALE;
+						}
+						return buckets[ bucket ].first - 1;
+					}
+				}
+				return size;
+			}
+
+			size_t findNext( size_t position ) const {
+				return next[ position ] == NONE ? size : next[ position ];
+			}
+		};
+
+		// lazily built KeyIndex of a node
+		// safe to use from concurrent const lookups: indices are installed atomically and
+		// are only freed by non-const operations
+		// it stays valid across non-const access: adding children updates it, and changes to keys
+		// (see keysChanged) make the next lookup check the keys against their hashes
+		struct KeyIndexCache {
+			mutable std::atomic< KeyIndex * > index;
+
+			// returns nullptr for small nodes
+			template< typename NodeContainer >
+			const KeyIndex *get( const NodeContainer &nodes ) const {
+				if( nodes.size() < KeyIndex::minimumSize ) {
+					return nullptr;
+				}
+
+				const size_t generation = observeKeyGeneration();
+				KeyIndex *current = index.load( std::memory_order_acquire );
+				while( true ) {
+					if( current && current->isValidFor( nodes ) ) {
+						if( current->generation.load( std::memory_order_relaxed ) == generation ) {
+							return current;
+						}
+						// checking the keys is cheaper than rebuilding (and doesn't retire anything)
+						if( current->matches( nodes ) ) {
+							current->generation.store( generation, std::memory_order_relaxed );
+							return current;
+						}
+					}
+
+					// nodes has been changed directly: replace the outdated index but keep it alive
+					KeyIndex *rebuilt = new KeyIndex( nodes, generation );
+					rebuilt->retired.reset( current );
+
+					if( index.compare_exchange_strong( current, rebuilt, std::memory_order_acq_rel, std::memory_order_acquire ) ) {
+						return rebuilt;
+					}
+
+					// another thread has been faster
+					rebuilt->retired.release();
+					delete rebuilt;
+				}
+			}
+
+			// called by non-const operations after a child has been appended to nodes
+			// (previousData is nodes.data() before appending)
+			template< typename NodeContainer >
+			void appended( const NodeContainer &nodes, const void *previousData ) {
+				KeyIndex *current = index.load( std::memory_order_relaxed );
+				if( !current ) {
+					return;
+				}
+
+				const bool isCurrent = current->data == previousData && current->size + 1 == nodes.size() &&
+					current->generation.load( std::memory_order_relaxed ) == keyGeneration().load( std::memory_order_relaxed );
+				if( isCurrent && current->append( nodes ) ) {
+					// no const lookups can run concurrently
+					current->retired.reset();
+				}
+				else {
+					reset();
+				}
+			}
+
+			void reset() {
+				if( index.load( std::memory_order_relaxed ) ) {
+					delete index.exchange( nullptr, std::memory_order_acq_rel );
+				}
+			}
+
+			KeyIndexCache() : index( nullptr ) {}
+			// indices are never shared
+			KeyIndexCache( const KeyIndexCache & ) : index( nullptr ) {}
+			// moved containers keep their storage, so the index stays valid
+			KeyIndexCache( KeyIndexCache &&cache ) noexcept : index( cache.index.exchange( nullptr ) ) {}
+
+			// assigning a node changes the key at its position (std::sort, erase, ... on nodes)
+			KeyIndexCache & operator = ( const KeyIndexCache & ) {
+				keysChanged();
+				reset();
+				return *this;
+			}
+
+			KeyIndexCache & operator = ( KeyIndexCache &&cache ) noexcept {
+				keysChanged();
+				if( this != &cache ) {
+					reset();
+					index = cache.index.exchange( nullptr );
+				}
+				return *this;
+			}
+
+			~KeyIndexCache() {
+				reset();
+			}
+		};
+
+		// lazy views over the children of a node (see Node::children, Node::keys and Node::values)
+		// they never allocate and only stay valid as long as the node isn't modified
+
+		template< typename Iterator >
+		struct IteratorRange {
+			Iterator first;
+			Iterator last;
+
+			Iterator begin() const {
+				return first;
+			}
+
+			Iterator end() const {
+				return last;
+			}
+
+			bool empty() const {
+				return first == last;
+			}
+
+			IteratorRange() {}
+			IteratorRange( Iterator first, Iterator last ) : first( first ), last( last ) {}
+		};
+
+		// iterates over all children with a given key
+		template< typename NodeT >
+		struct ChildIterator {
+			typedef std::forward_iterator_tag iterator_category;
+			typedef typename std::remove_const< NodeT >::type value_type;
+			typedef std::ptrdiff_t difference_type;
+			typedef NodeT * pointer;
+			typedef NodeT & reference;
+
+			NodeT *node;
+			size_t position;
+
+			reference operator * () const {
+				return (*node)[ int( position ) ];
+			}
+
+			pointer operator -> () const {
+				return &**this;
+			}
+
+			ChildIterator & operator ++ () {
+				position = node->findNextPosition( position );
+				return *this;
+			}
+
+			ChildIterator operator ++ ( int ) {
+				ChildIterator old( *this );
+				++*this;
+				return old;
+			}
+
+			bool operator == ( const ChildIterator &other ) const {
+				return position == other.position;
+			}
+
+			bool operator != ( const ChildIterator &other ) const {
+				return position != other.position;
+			}
+
+			ChildIterator() : node( nullptr ), position( 0 ) {}
+			ChildIterator( NodeT &node, size_t position ) : node( &node ), position( position ) {}
+		};
+
+		// iterates over the content of all children
+		// (String & for non-const nodes, std::string_view for const nodes)
+		template< typename NodeT >
+		struct ContentIterator {
+			typedef typename std::remove_const< NodeT >::type::String String;
+
+			typedef std::forward_iterator_tag iterator_concept;
+			typedef typename std::conditional< std::is_const< NodeT >::value, std::input_iterator_tag, std::forward_iterator_tag >::type iterator_category;
+			typedef typename std::conditional< std::is_const< NodeT >::value, std::string_view, String >::type value_type;
+			typedef std::ptrdiff_t difference_type;
+			typedef typename std::conditional< std::is_const< NodeT >::value, std::string_view, String & >::type reference;
+			typedef void pointer;
+
+			NodeT *node;
+			size_t position;
+
+			reference operator * () const {
+				// const nodes can read packed values directly
+				if constexpr( std::is_const< NodeT >::value ) {
+					return node->valueAt( position );
+				}
+				else {
+					return (*node)[ int( position ) ].key();
+				}
+			}
+
+			ContentIterator & operator ++ () {
+				++position;
+				return *this;
+			}
+
+			ContentIterator operator ++ ( int ) {
+				ContentIterator old( *this );
+				++*this;
+				return old;
+			}
+
+			bool operator == ( const ContentIterator &other ) const {
+				return position == other.position;
+			}
+
+			bool operator != ( const ContentIterator &other ) const {
+				return position != other.position;
+			}
+
+			ContentIterator() : node( nullptr ), position( 0 ) {}
+			ContentIterator( NodeT &node, size_t position ) : node( &node ), position( position ) {}
+		};
+
+		// where a parsed node is in the source text (see emitPreserving)
+		struct SourceSpan {
+			static const uint32_t NONE = uint32_t( -1 );
+
+			// [begin, end) of the entry: from the start of its first line to the end of its last line
+			// (including the empty lines inside a map)
+			uint32_t begin, end;
+			// number of children after parsing (to notice changes to nodes)
+			uint32_t numChildren;
+			// hash of the content after parsing (to notice changes to the content)
+			size_t contentHash;
+			// set by markModified() and the methods that add children
+			bool modified;
+
+			bool isValid() const {
+				return begin != NONE;
+			}
+
+			static size_t hash( std::string_view content ) {
+				return std::hash< std::string_view >()( content );
+			}
+
+			// false if the node has been marked or its content differs from the parsed one
+			bool isUnchanged( std::string_view content ) const {
+				return !modified && contentHash == hash( content );
+			}
+
+			SourceSpan() : begin( NONE ), end( NONE ), numChildren( 0 ), contentHash( 0 ), modified( false ) {}
+		};
+
+		// compact storage for long lists of leaf values (see ParseOptions)
+		// all values share one buffer and the context of the list
+		template< typename NodeT >
+		struct BasicPackedValues {
+			typedef typename NodeT::NodeContainer NodeContainer;
+
+			// value i is text[ offsets[i], offsets[i + 1] )
+			std::string text;
+			std::vector< uint32_t > offsets;
+			typename NodeT::Context context;
+
+			// children for code that needs them (created on demand)
+			mutable std::atomic< NodeContainer * > unpackedNodes;
+
+			size_t size() const {
+				return offsets.size() - 1;
+			}
+
+			std::string_view at( size_t i ) const {
+				return std::string_view( text.data() + offsets[ i ], offsets[ i + 1 ] - offsets[ i ] );
+			}
+
+			void push_back( std::string_view value ) {
+				text.append( value.data(), value.size() );
+				offsets.push_back( uint32_t( text.size() ) );
+			}
+
+			NodeContainer unpack() const {
+				NodeContainer nodes;
+				nodes.reserve( size() );
+				for( size_t i = 0 ; i < size() ; ++i ) {
+					nodes.push_back( NodeT( makeString< typename NodeT::String >( at( i ) ), context ) );
+				}
+				return nodes;
+			}
+
+			const NodeContainer &unpacked() const {
+				NodeContainer *nodes = unpackedNodes.load( std::memory_order_acquire );
+				if( !nodes ) {
+					NodeContainer *created = new NodeContainer( unpack() );
+					if( unpackedNodes.compare_exchange_strong( nodes, created, std::memory_order_acq_rel, std::memory_order_acquire ) ) {
+						nodes = created;
+					}
+					else {
+						// another thread has been faster
+						delete created;
+					}
+				}
+				return *nodes;
+			}
+
+			BasicPackedValues() : offsets( 1, 0 ), unpackedNodes( nullptr ) {}
+			~BasicPackedValues() {
+				delete unpackedNodes.load();
+			}
+		};
+	}
+
+	// a node of a WML tree: a key (or value) and its children
+	//
+	// Traits choose how the tree is stored (see DefaultNodeTraits), all trees use the same
+	// parser and emitter:
+	//
+	//	CompactNode tree = parse< CompactNode >( text );
+	//	std::string text = emit( tree );
+	template< typename Traits >
+	struct BasicNode {
+		typedef typename Traits::String String;
+		typedef typename Traits::template Container< BasicNode > NodeContainer;
+		typedef typename NodeContainer::iterator iterator;
+		typedef typename NodeContainer::const_iterator const_iterator;
+
+		static const bool keepsContext = Traits::keepsContext;
+		typedef typename std::conditional< keepsContext, LeanTextProcessing::TextContext, detail::NoContext >::type Context;
+		typedef detail::BasicPackedValues< BasicNode > PackedValues;
 
 		// the internal implementation only uses these fields
-		LeanTextProcessing::TextContext context;
-		std::string content;
+		Context context;
+		String content;
 		NodeContainer nodes;
+		// if set, the children are stored here and nodes is empty
+		// const accessors read from it directly or use a shared unpacked copy,
+		// non-const accessors unpack it into nodes first
+		std::shared_ptr< const PackedValues > packed;
+
+		// hash index for key lookups (built on demand for big nodes)
+		// it notices children that are added, assigned or renamed through key() (also through references
+		// obtained earlier), but not writes to the content of children: call invalidateKeyIndex() after those
+		detail::KeyIndexCache keyIndex;
+
+		// source position of parsed nodes for emitPreserving (only with ParseOptions::trackSourceSpans)
+		// changes to the content and the number of children are noticed when emitting (however they are made),
+		// markModified() forces the node to be emitted anew
+		detail::SourceSpan span;
+
+		void markModified() {
+			span.modified = true;
+		}
+
+		//////////////////////////////////////////////////////////////////////////
+		// access to the children (handles packed values)
+
+		const NodeContainer & childNodes() const {
+			return packed ? packed->unpacked() : nodes;
+		}
+
+		NodeContainer & childNodes() {
+			unpack();
+			return nodes;
+		}
+
+		void unpack() {
+			if( packed ) {
+				nodes = packed->unpack();
+				packed.reset();
+				keyIndex.reset();
+			}
+		}
+
+		// content of the i-th child
+		std::string_view valueAt( size_t i ) const {
+			return packed ? packed->at( i ) : std::string_view( nodes[ i ].content );
+		}
 
 		//////////////////////////////////////////////////////////////////////////
 		// syntactic sugar
 		
-		std::string & key() {
+		// renaming through the returned reference is noticed by the key indices of all nodes
+		String & key() {
+			detail::keysChanged();
 			return content;
 		}
 
-		const std::string & key() const {
+		const String & key() const {
 			return content;
 		}
 
-		std::string & value() {
-			if( nodes.empty() ) {
+		String & value() {
+			if( empty() ) {
 				error( "expected data at node!" );
 			}
-			else if( nodes.size() > 1 ) {
+			else if( size() > 1 ) {
 				error( "expected data at node, found array/map!" );
 			}
 
-			return nodes[0].content;
+			return childNodes()[0].content;
 		}
 
-		const std::string & value() const {
-			if( nodes.empty() ) {
+		const String & value() const {
+			if( empty() ) {
 				error( "expected data at node!" );
 			}
-			else if( nodes.size() > 1 ) {
+			else if( size() > 1 ) {
 				error( "expected data at node, found array/map!" );
 			}
 
-			return nodes[0].content;
+			return childNodes()[0].content;
 		}
 
-		Node & operator[] ( int i ) {
-			return nodes[ i ];
+		BasicNode & operator[] ( int i ) {
+			return childNodes()[ i ];
 		}
 
-		const Node & operator[] ( int i ) const {
-			return nodes[ i ];
+		const BasicNode & operator[] ( int i ) const {
+			return childNodes()[ i ];
 		}
 
 		size_t size() const {
-			return nodes.size();
+			return packed ? packed->size() : nodes.size();
 		}
 
 		bool empty() const {
-			return nodes.empty();
+			return size() == 0;
 		}
 
 		iterator begin() {
-			return nodes.begin();
+			return childNodes().begin();
 		}
 
 		iterator end() {
-			return nodes.end();
+			return childNodes().end();
+		}
+
+		const_iterator begin() const {
+			return childNodes().cbegin();
+		}
+
+		const_iterator end() const {
+			return childNodes().cend();
 		}
 
 		const_iterator cbegin() const {
-			return nodes.cbegin();
+			return childNodes().cbegin();
 		}
 
 		const_iterator cend() const {
-			return nodes.cend();
+			return childNodes().cend();
+		}
+
+		// lazy views (range-for and std::ranges)
+
+		// all children with the given key
+		detail::IteratorRange< detail::ChildIterator< BasicNode > > children( std::string_view key ) {
+			typedef detail::ChildIterator< BasicNode > Iterator;
+			childNodes();
+			return detail::IteratorRange< Iterator >( Iterator( *this, findPosition( key ) ), Iterator( *this, size() ) );
+		}
+
+		detail::IteratorRange< detail::ChildIterator< const BasicNode > > children( std::string_view key ) const {
+			typedef detail::ChildIterator< const BasicNode > Iterator;
+			return detail::IteratorRange< Iterator >( Iterator( *this, findPosition( key ) ), Iterator( *this, size() ) );
+		}
+
+		// keys of all children (of a map)
+		detail::IteratorRange< detail::ContentIterator< BasicNode > > keys() {
+			typedef detail::ContentIterator< BasicNode > Iterator;
+			childNodes();
+			return detail::IteratorRange< Iterator >( Iterator( *this, 0 ), Iterator( *this, size() ) );
+		}
+
+		detail::IteratorRange< detail::ContentIterator< const BasicNode > > keys() const {
+			typedef detail::ContentIterator< const BasicNode > Iterator;
+			return detail::IteratorRange< Iterator >( Iterator( *this, 0 ), Iterator( *this, size() ) );
+		}
+
+		// all values (of a value list)
+		// note: values are stored as the keys of leaf children, so this is the same as keys()
+		detail::IteratorRange< detail::ContentIterator< BasicNode > > values() {
+			return keys();
 		}
 
-		iterator find( const std::string &key ) {
-			auto node = nodes.begin();
-			for( ; node != nodes.end() ; ++node ) {
-				if( node->content == key ) {
+		detail::IteratorRange< detail::ContentIterator< const BasicNode > > values() const {
+			return keys();
+		}
+
+		// position of the first child with the given key at or after from (or nodes.size())
+		static size_t scanPosition( const NodeContainer &nodes, std::string_view key, size_t from ) {
+			size_t position = from;
+			for( ; position < nodes.size() ; ++position ) {
+				if( nodes[ position ].content == key ) {
 					break;
 				}
 			}
-			return node;
+			return position;
 		}
 
-		const_iterator find( const std::string &key ) const {
-			auto node = nodes.cbegin();
-			for( ; node != nodes.cend() ; ++node ) {
-				if( node->content == key ) {
-					break;
+		// position of the first child with the given key (or size())
+		size_t findPosition( std::string_view key ) const {
+			const NodeContainer &nodes = childNodes();
+
+			const detail::KeyIndex *index = keyIndex.get( nodes );
+			if( index ) {
+				const size_t position = index->findFirst( nodes, key );
+				if( position != detail::KeyIndex::STALE ) {
+					return position;
 				}
 			}
-			return node;
+
+			return scanPosition( nodes, key, 0 );
 		}
 
-		Node & operator[] ( const std::string &key ) {
-			for( auto item = nodes.begin() ; item != nodes.end() ; ++item ) {
-				if( item->content == key ) {
-					return *item;
+		// position of the next child with the same key as the child at position (or size())
+		size_t findNextPosition( size_t position ) const {
+			const NodeContainer &nodes = childNodes();
+			const std::string_view key = nodes[ position ].content;
+
+			const detail::KeyIndex *index = keyIndex.get( nodes );
+			if( index ) {
+				// verify the hit (see findPosition)
+				const size_t next = index->findNext( position );
+				if( next == nodes.size() || nodes[ next ].content == key ) {
+					return next;
 				}
 			}
 
-			error( boost::str( boost::format( "key '%s' not found!" ) % key ) );
+			return scanPosition( nodes, key, position + 1 );
 		}
 
-		const Node & operator[] ( const std::string &key ) const {
-			for( auto item = nodes.begin() ; item != nodes.end() ; ++item ) {
-				if( item->content == key ) {
-					return *item;
-				}
+		iterator find( std::string_view key ) {
+			unpack();
+			return nodes.begin() + findPosition( key );
+		}
+
+		const_iterator find( std::string_view key ) const {
+			return childNodes().cbegin() + findPosition( key );
+		}
+
+		BasicNode & operator[] ( std::string_view key ) {
+			unpack();
+			const size_t position = findPosition( key );
+			if( position == nodes.size() ) {
+				error( boost::str( boost::format( "key '%s' not found!" ) % key ) );
+			}
+			return nodes[ position ];
+		}
+
+		const BasicNode & operator[] ( std::string_view key ) const {
+			const size_t position = findPosition( key );
+			if( position == size() ) {
+				error( boost::str( boost::format( "key '%s' not found!" ) % key ) );
 			}
+			return childNodes()[ position ];
+		}
 
-			error( boost::str( boost::format( "key '%s' not found!" ) % key ) );
+		// call this after writing the content of children directly (see keyIndex)
+		void invalidateKeyIndex() {
+			keyIndex.reset();
 		}
 
+		// throws a TextException at the position of the i-th value
+		[[noreturn]] void valueError( size_t i, const std::string &message ) const {
+			if( packed ) {
+				throw LeanTextProcessing::TextException( detail::textContext( packed->context ), message );
+			}
+			nodes[ i ].error( message );
+		}
+
+		// conversion errors are reported at the position of the value (see Converter)
 		template< typename T >
 		T as() const {
-			return boost::lexical_cast<T>( value() );
+			const std::string_view text = value();
+
+			T result = T();
+			if( !Converter< T >::parse( text, result ) ) {
+				valueError( 0, boost::str( boost::format( "cannot convert '%s' to %s!" ) % text % detail::typeName< T >() ) );
+			}
+			return result;
+		}
+
+		// converts all values (of a value list)
+		template< typename T >
+		std::vector< T > asArray() const {
+			std::vector< T > values( size() );
+			for( size_t i = 0 ; i < values.size() ; ++i ) {
+				T value = T();
+				convertValue( i, value );
+				values[ i ] = value;
+			}
+			return values;
+		}
+
+		// converts all values into a preallocated array (with exactly size() elements)
+		template< typename T >
+		void readInto( T *values, size_t count ) const {
+			if( count != size() ) {
+				error( boost::str( boost::format( "expected %i values, found %i!" ) % count % size() ) );
+			}
+
+			for( size_t i = 0 ; i < count ; ++i ) {
+				convertValue( i, values[ i ] );
+			}
+		}
+
+#ifdef __cpp_lib_span
+		template< typename T >
+		void readInto( std::span< T > values ) const {
+			readInto( values.data(), values.size() );
+		}
+#endif
+
+		template< typename T >
+		void convertValue( size_t i, T &value ) const {
+			const std::string_view text = valueAt( i );
+			if( !Converter< T >::parse( text, value ) ) {
+				valueError( i, boost::str( boost::format( "cannot convert '%s' to %s!" ) % text % detail::typeName< T >() ) );
+			}
 		}
 
 		template< typename T >
 		void setValue( const T &newValue ) {
+			unpack();
 			if( empty() ) {
-				nodes.push_back( Node() );
+				nodes.push_back( BasicNode() );
 			}
 			else if( nodes.size() > 1 ) {
 				error( "expected data at node, found array/map!" );
 			}
 
-			value() = boost::lexical_cast< std::string >( newValue );
+			detail::formatInto( newValue, value() );
 		}
 
 		template< typename T >
-		T get( const std::string &key ) const {
-			return (*this)[ key ].as<T>();
+		T get( std::string_view key ) const {
+			return (*this)[ key ].template as<T>();
 		}
 
 		template< typename T >
-		T getOr( const std::string &key, const T &defaultValue ) const {
+		T getOr( std::string_view key, const T &defaultValue ) const {
 			auto node = find( key );
 
 			if( node != cend() ) {
-				return node->as<T>();
+				return node->template as<T>();
 			}
 
 			return defaultValue;
 		}
 
-		std::vector< iterator > getNodes( const std::string &key ) {
+		// non-throwing lookups for optional keys
+
+		BasicNode * findPtr( std::string_view key ) {
+			unpack();
+			const size_t position = findPosition( key );
+			return position < nodes.size() ? &nodes[ position ] : nullptr;
+		}
+
+		const BasicNode * findPtr( std::string_view key ) const {
+			const size_t position = findPosition( key );
+			return position < size() ? &childNodes()[ position ] : nullptr;
+		}
+
+		// returns nothing if the key doesn't exist (like getOr)
+		template< typename T >
+		std::optional< T > tryGet( std::string_view key ) const {
+			const BasicNode *node = findPtr( key );
+
+			if( node ) {
+				return node->template as<T>();
+			}
+
+			return std::nullopt;
+		}
+
+		std::vector< iterator > getNodes( std::string_view key ) {
 			std::vector< iterator > results;
 
-			for( auto item = nodes.begin() ; item != nodes.end() ; ++item ) {
-				if( item->content == key ) {
-					results.push_back( item );
-				}
+			unpack();
+			for( size_t position = findPosition( key ) ; position < nodes.size() ; position = findNextPosition( position ) ) {
+				results.push_back( nodes.begin() + position );
 			}
 
 			return results;
 		}
 
-		Node &push_back( Node &&node ) {
-			nodes.push_back( node );
+		BasicNode &push_back( BasicNode &&node ) {
+			markModified();
+			unpack();
+			const void *previousData = nodes.data();
+			nodes.push_back( std::move( node ) );
+			keyIndex.appended( nodes, previousData );
 			return nodes.back();
 		}
 
-		Node &push_back( const Node &node ) {
+		BasicNode &push_back( const BasicNode &node ) {
+			markModified();
+			unpack();
+			const void *previousData = nodes.data();
 			nodes.push_back( node );
+			keyIndex.appended( nodes, previousData );
 			return nodes.back();
 		}
 
-		Node &push_back( const std::string &content ) {
-			push_back( Node( content ) );
+		BasicNode &push_back( const std::string &content ) {
+			push_back( BasicNode( detail::makeString< String >( std::string_view( content ) ) ) );
 			return nodes.back();
 		} 
 
-		Node &push_back( std::string &&content ) {
-			push_back( Node( std::move( content ) ) );
+		BasicNode &push_back( std::string &&content ) {
+			push_back( BasicNode( detail::makeString< String >( std::move( content ) ) ) );
 			return nodes.back();
 		} 
 
+		BasicNode &push_back( const char *content ) {
+			push_back( BasicNode( String( content ) ) );
+			return nodes.back();
+		}
+
 		template< typename T>
-		Node &push_back( const T &content ) {
-			push_back( Node( boost::lexical_cast< std::string >( content ) ) );
+		BasicNode &push_back( const T &content ) {
+			BasicNode node;
+			detail::formatInto( content, node.content );
+			push_back( std::move( node ) );
 			return nodes.back();
 		}
 
-		Node() {}
-		Node( std::string &&content ) : content( std::move( content ) ) {}
-		Node( const std::string &content ) : content( content ) {}
-		Node( const std::string &content, const LeanTextProcessing::TextContext &context ) : content( content ), context( context ) {}
+		// constructs the child in place (with the arguments of a BasicNode constructor)
+		template< typename... Args >
+		BasicNode &emplace_back( Args &&...args ) {
+			markModified();
+			unpack();
+			const void *previousData = nodes.data();
+			nodes.emplace_back( std::forward< Args >( args )... );
+			keyIndex.appended( nodes, previousData );
+			return nodes.back();
+		}
+
+		// preallocates storage for capacity children
+		void reserve( size_t capacity ) {
+			childNodes().reserve( capacity );
+		}
+
+		BasicNode() {}
+		BasicNode( String &&content ) : content( std::move( content ) ) {}
+		BasicNode( const String &content ) : content( content ) {}
+		BasicNode( const String &content, const Context &context ) : context( context ), content( content ) {}
+		BasicNode( String &&content, Context &&context ) : context( std::move( context ) ), content( std::move( content ) ) {}
+
+		BasicNode( const BasicNode &node ) = default;
+		BasicNode & operator = ( const BasicNode &node ) = default;
 
-		// move semantics
-		Node( Node &&node ) : content( std::move( node.content ) ), nodes( std::move( node.nodes ) ), context( std::move( node.context ) ) {}
-		Node & operator == ( Node &&node ) {
+		// move semantics (noexcept, so vectors of nodes move them when they grow)
+		BasicNode( BasicNode &&node ) noexcept : context( std::move( node.context ) ), content( std::move( node.content ) ), nodes( std::move( node.nodes ) ), packed( std::move( node.packed ) ), keyIndex( std::move( node.keyIndex ) ), span( node.span ) {}
+		BasicNode & operator = ( BasicNode &&node ) noexcept {
+			context = std::move( node.context );
 			content = std::move( node.content );
 			nodes = std::move( node.nodes );
-			context = std::move( node.context );
+			packed = std::move( node.packed );
+			keyIndex = std::move( node.keyIndex );
+			span = node.span;
+			return *this;
 		}
 
-		void error( const std::string &message ) const {
-			throw LeanTextProcessing::TextException( context, message );
+		[[noreturn]] void error( const std::string &message ) const {
+			throw LeanTextProcessing::TextException( detail::textContext( context ), message );
 		}
 	};
-}
\ No newline at end of file
+
+	typedef BasicNode< DefaultNodeTraits > Node;
+	typedef BasicNode< CompactNodeTraits > CompactNode;
+#ifdef __cpp_lib_memory_resource
+	typedef BasicNode< PmrNodeTraits > PmrNode;
+#endif
+
+	namespace detail {
+		// the packed values of parsed Node trees
+		typedef BasicPackedValues< Node > PackedValues;
+	}
+}
+
+#ifdef __cpp_lib_ranges
+// the views only refer to the node, so they are cheap to copy and can be passed around by value
+namespace std::ranges {
+	template< typename Iterator >
+	inline constexpr bool enable_view< wml::detail::IteratorRange< Iterator > > = true;
+
+	template< typename Iterator >
+	inline constexpr bool enable_borrowed_range< wml::detail::IteratorRange< Iterator > > = true;
+}
+#endif
@@ -0,0 +1,331 @@
+/*
+Copyright 2013 Andreas Kirsch
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <iterator>
+
+#include "wml_node.h"
+
+namespace wml {
+	// query that is compiled once and can be evaluated against many nodes
+	//
+	// syntax: segments separated by '/'
+	//	key			first child with the given key
+	//	key[n]		n-th child with the given key (0-based)
+	//	key[*]		all children with the given key
+	//	*			all children
+	//	*[n]		n-th child
+	// keys can be put in single quotes: 'a key with spaces/slashes'
+	//
+	// example: streams/stream[*]/flags/write/users
+	struct Path {
+		enum SegmentType {
+			ST_KEY,
+			ST_ANY
+		};
+
+		static constexpr size_t ALL = size_t( -1 );
+		static constexpr size_t NONE = size_t( -1 );
+
+		struct Segment {
+			SegmentType type;
+			std::string key;
+			// ALL or the index of the occurrence
+			size_t index;
+
+			// position of the first matching child of node (or NONE)
+			template< typename NodeT >
+			size_t first( const NodeT &node ) const {
+				if( type == ST_ANY ) {
+					if( index == ALL ) {
+						return node.empty() ? NONE : 0;
+					}
+					return index < node.size() ? index : NONE;
+				}
+
+				size_t position = node.findPosition( key );
+				for( size_t occurrence = 0 ; occurrence != index && index != ALL && position < node.size() ; ++occurrence ) {
+					position = node.findNextPosition( position );
+				}
+				return position < node.size() ? position : NONE;
+			}
+
+			// position of the next matching child after position (or NONE)
+			template< typename NodeT >
+			size_t next( const NodeT &node, size_t position ) const {
+				if( index != ALL ) {
+					return NONE;
+				}
+
+				if( type == ST_ANY ) {
+					++position;
+				}
+				else {
+					position = node.findNextPosition( position );
+				}
+				return position < node.size() ? position : NONE;
+			}
+		};
+
+		std::string text;
+		std::vector< Segment > segments;
+
+		// evaluates a path lazily (depth-first)
+		// no allocations are needed for paths with up to inlineDepth segments
+		template< typename NodeT >
+		struct Iterator {
+			typedef std::forward_iterator_tag iterator_category;
+			typedef Node value_type;
+			typedef std::ptrdiff_t difference_type;
+			typedef NodeT * pointer;
+			typedef NodeT & reference;
+
+			static constexpr size_t inlineDepth = 8;
+
+			struct Frame {
+				NodeT *parent;
+				size_t position;
+			};
+
+			const Path *path;
+			Frame inlineFrames[ inlineDepth ];
+			std::vector< Frame > extraFrames;
+			// the root itself matches the empty path
+			NodeT *root;
+
+			Frame &frame( size_t level ) {
+				return level < inlineDepth ? inlineFrames[ level ] : extraFrames[ level - inlineDepth ];
+			}
+
+			const Frame &frame( size_t level ) const {
+				return level < inlineDepth ? inlineFrames[ level ] : extraFrames[ level - inlineDepth ];
+			}
+
+			NodeT &child( const Frame &frame ) const {
+				return (*frame.parent)[ int( frame.position ) ];
+			}
+
+			// find the first match in the subtree below frame( level ).parent
+			// and backtrack if there is none
+			void descend( size_t level ) {
+				const size_t depth = path->segments.size();
+
+				while( level < depth ) {
+					Frame &current = frame( level );
+					current.position = path->segments[ level ].first( *current.parent );
+
+					if( current.position == NONE ) {
+						if( !backtrack( level ) ) {
+							return;
+						}
+						// backtrack has moved frame( level - 1 ) to its next match
+					}
+					else {
+						++level;
+						if( level == depth ) {
+							break;
+						}
+						frame( level ).parent = &child( current );
+					}
+				}
+			}
+
+			// move to the next match of the nearest level above level that has one
+			// returns false (and turns into the end iterator) if there is none
+			bool backtrack( size_t &level ) {
+				while( level > 0 ) {
+					--level;
+					Frame &current = frame( level );
+					current.position = path->segments[ level ].next( *current.parent, current.position );
+
+					if( current.position != NONE ) {
+						++level;
+						if( level < path->segments.size() ) {
+							frame( level ).parent = &child( current );
+						}
+						return true;
+					}
+				}
+
+				path = nullptr;
+				return false;
+			}
+
+			reference operator * () const {
+				if( path->segments.empty() ) {
+					return *root;
+				}
+				return child( frame( path->segments.size() - 1 ) );
+			}
+
+			pointer operator -> () const {
+				return &**this;
+			}
+
+			Iterator & operator ++ () {
+				size_t level = path->segments.size();
+				if( level == 0 ) {
+					path = nullptr;
+				}
+				else if( backtrack( level ) ) {
+					descend( level );
+				}
+				return *this;
+			}
+
+			Iterator operator ++ ( int ) {
+				Iterator old( *this );
+				++*this;
+				return old;
+			}
+
+			bool operator == ( const Iterator &other ) const {
+				if( !path || !other.path ) {
+					return path == other.path;
+				}
+				return &**this == &*other;
+			}
+
+			bool operator != ( const Iterator &other ) const {
+				return !(*this == other);
+			}
+
+			// end iterator
+			Iterator() : path( nullptr ), root( nullptr ) {}
+
+			Iterator( const Path &path, NodeT &root ) : path( &path ), root( &root ) {
+				if( path.segments.size() > inlineDepth ) {
+					extraFrames.resize( path.segments.size() - inlineDepth );
+				}
+				if( !path.segments.empty() ) {
+					frame( 0 ).parent = &root;
+					descend( 0 );
+				}
+			}
+		};
+
+		template< typename NodeT >
+		struct Range {
+			typedef Iterator< NodeT > iterator;
+
+			const Path *path;
+			NodeT *root;
+
+			iterator begin() const {
+				return iterator( *path, *root );
+			}
+
+			iterator end() const {
+				return iterator();
+			}
+
+			bool empty() const {
+				return begin() == end();
+			}
+
+			size_t count() const {
+				return std::distance( begin(), end() );
+			}
+
+			Range( const Path &path, NodeT &root ) : path( &path ), root( &root ) {}
+		};
+
+		// the path must outlive the returned range
+		Range< Node > select( Node &root ) const {
+			return Range< Node >( *this, root );
+		}
+
+		Range< const Node > select( const Node &root ) const {
+			return Range< const Node >( *this, root );
+		}
+
+		// first match or nullptr
+		Node * first( Node &root ) const {
+			auto matches = select( root );
+			auto match = matches.begin();
+			return match != matches.end() ? &*match : nullptr;
+		}
+
+		const Node * first( const Node &root ) const {
+			auto matches = select( root );
+			auto match = matches.begin();
+			return match != matches.end() ? &*match : nullptr;
+		}
+
+		explicit Path( const std::string &text ) : text( text ) {
+			using namespace LeanTextProcessing;
+
+			TextContainer textContainer( text, "path" );
+			TextIterator textIterator( textContainer, TextPosition() );
+
+			while( !textIterator.isAtEnd() ) {
+				Segment segment;
+				segment.index = ALL;
+
+				if( textIterator.tryMatch( '\'' ) ) {
+					segment.type = ST_KEY;
+					while( textIterator.checkNot( '\'' ) ) {
+						segment.key.push_back( textIterator.read() );
+					}
+					if( !textIterator.tryMatch( '\'' ) ) {
+						textIterator.error( "' expected!" );
+					}
+				}
+				else {
+					while( textIterator.checkNotAny( "/[]'" ) ) {
+						segment.key.push_back( textIterator.read() );
+					}
+					if( segment.key.empty() ) {
+						textIterator.error( "expected key!" );
+					}
+					segment.type = segment.key == "*" ? ST_ANY : ST_KEY;
+				}
+
+				if( textIterator.tryMatch( '[' ) ) {
+					if( !textIterator.tryMatch( '*' ) ) {
+						std::string index;
+						while( textIterator.checkAny( "0123456789" ) ) {
+							index.push_back( textIterator.read() );
+						}
+						if( index.empty() ) {
+							textIterator.error( "expected index or '*'!" );
+						}
+						segment.index = boost::lexical_cast< size_t >( index );
+					}
+					if( !textIterator.tryMatch( ']' ) ) {
+						textIterator.error( "']' expected!" );
+					}
+				}
+				else if( segment.type == ST_KEY ) {
+					segment.index = 0;
+				}
+
+				segments.push_back( std::move( segment ) );
+
+				if( !textIterator.isAtEnd() && !textIterator.tryMatch( '/' ) ) {
+					textIterator.error( "'/' expected!" );
+				}
+			}
+		}
+	};
+}
@@ -0,0 +1,470 @@
+/*
+Copyright 2013 Andreas Kirsch
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <algorithm>
+#include <limits>
+
+#include "wml.h"
+
+namespace wml {
+	// a problem found by Schema::validate
+	struct Violation {
+		LeanTextProcessing::TextContext context;
+		std::string message;
+
+		// same format as TextException::what()
+		std::string describe() const {
+			return LeanTextProcessing::TextException( context, message ).message;
+		}
+
+		Violation( const LeanTextProcessing::TextContext &context, const std::string &message ) : context( context ), message( message ) {}
+	};
+
+	// declares the allowed structure of documents and validates documents against it
+	//
+	// a schema is written in WML: every entry declares a key, its properties are
+	//	type			string (default), int, float, bool, map or any (not checked)
+	//	count			how often the key may appear: N, N..M, N..* or * (default 1)
+	//	values			how many values the key has: N, N..M, N..* or * (default 1)
+	//	one-of			the allowed values
+	//	keys:			declarations of the keys of a map (implies type map)
+	//
+	// example:
+	//	server:
+	//		keys:
+	//			host
+	//			port:
+	//				type int
+	//			users:
+	//				count 0..1
+	//				values 1..*
+	//			mode:
+	//				one-of read write
+	//
+	// keys that are not declared are violations
+	//
+	// note: a tree can't tell 'key a b' from a map with the keys a and b, so validate( node ) reads the
+	// children of an entry as whatever its rule expects (validateText doesn't have this problem)
+	struct Schema {
+		enum ValueType {
+			VT_STRING,
+			VT_INT,
+			VT_FLOAT,
+			VT_BOOL,
+			VT_MAP,
+			VT_ANY
+		};
+
+		static constexpr size_t UNBOUNDED = std::numeric_limits< size_t >::max();
+		static constexpr size_t NONE = size_t( -1 );
+
+		struct Rule {
+			std::string key;
+			ValueType type;
+			size_t minCount, maxCount;
+			size_t minValues, maxValues;
+			std::vector< std::string > allowedValues;
+
+			// for maps: the declared keys are rules[ firstChild, firstChild + numChildren ) (sorted by key)
+			size_t firstChild, numChildren;
+
+			Rule() : type( VT_STRING ), minCount( 1 ), maxCount( 1 ), minValues( 1 ), maxValues( 1 ), firstChild( 0 ), numChildren( 0 ) {}
+		};
+
+		// rules[0] is the document itself
+		std::vector< Rule > rules;
+
+		// rule for key inside the map rule parent (or NONE)
+		size_t find( size_t parent, std::string_view key ) const {
+			const auto first = rules.begin() + rules[ parent ].firstChild;
+			const auto last = first + rules[ parent ].numChildren;
+
+			const auto rule = std::lower_bound( first, last, key, []( const Rule &rule, std::string_view key ) { return rule.key < key; } );
+			if( rule != last && rule->key == key ) {
+				return rule - rules.begin();
+			}
+			return NONE;
+		}
+
+		static const char *typeName( ValueType type ) {
+			static const char *names[] = { "string", "int", "float", "bool", "map", "any" };
+			return names[ type ];
+		}
+
+		// true if text is a valid value for rule
+		bool checkValue( const Rule &rule, std::string_view text ) const {
+			typedef bool (*Check)( std::string_view text );
+			static const Check checks[] = {
+				[]( std::string_view ) { return true; },
+				[]( std::string_view text ) { long long value; return Converter< long long >::parse( text, value ); },
+				[]( std::string_view text ) { double value; return Converter< double >::parse( text, value ); },
+				[]( std::string_view text ) { bool value; return Converter< bool >::parse( text, value ); },
+				[]( std::string_view ) { return true; },
+				[]( std::string_view ) { return true; }
+			};
+
+			if( !checks[ rule.type ]( text ) ) {
+				return false;
+			}
+
+			return rule.allowedValues.empty() || std::find( rule.allowedValues.cbegin(), rule.allowedValues.cend(), text ) != rule.allowedValues.cend();
+		}
+
+		// validates a parsed tree
+		std::vector< Violation > validate( const Node &root ) const;
+		// validates text without building a tree (syntax errors are still thrown)
+		std::vector< Violation > validateText( std::string_view content, const std::string &sourceIdentifier = "" ) const;
+		std::vector< Violation > validateFile( const std::string &filename ) const;
+
+		explicit Schema( const Node &definition ) {
+			Rule document;
+			document.type = VT_MAP;
+			rules.push_back( document );
+
+			compileKeys( 0, definition );
+		}
+
+	private:
+		static void parseRange( const Node &property, size_t &min, size_t &max ) {
+			const std::string &text = property.value();
+
+			if( text == "*" ) {
+				min = 0;
+				max = UNBOUNDED;
+				return;
+			}
+
+			const size_t separator = text.find( ".." );
+			const std::string_view first = std::string_view( text ).substr( 0, separator );
+			bool isValid = Converter< size_t >::parse( first, min );
+			if( separator == std::string::npos ) {
+				max = min;
+			}
+			else {
+				const std::string_view last = std::string_view( text ).substr( separator + 2 );
+				if( last == "*" ) {
+					max = UNBOUNDED;
+				}
+				else {
+					isValid = isValid && Converter< size_t >::parse( last, max ) && min <= max;
+				}
+			}
+
+			if( !isValid ) {
+				property.error( boost::str( boost::format( "invalid range '%s'!" ) % text ) );
+			}
+		}
+
+		void compileKeys( size_t index, const Node &declarations ) {
+			std::vector< const Node * > sorted;
+			for( auto declaration = declarations.cbegin() ; declaration != declarations.cend() ; ++declaration ) {
+				sorted.push_back( &*declaration );
+			}
+			std::sort( sorted.begin(), sorted.end(), []( const Node *a, const Node *b ) { return a->content < b->content; } );
+
+			for( size_t i = 1 ; i < sorted.size() ; ++i ) {
+				if( sorted[ i - 1 ]->content == sorted[ i ]->content ) {
+					sorted[ i ]->error( boost::str( boost::format( "key '%s' is declared twice!" ) % sorted[ i ]->content ) );
+				}
+			}
+
+			const size_t firstChild = rules.size();
+			rules.resize( firstChild + sorted.size() );
+			rules[ index ].firstChild = firstChild;
+			rules[ index ].numChildren = sorted.size();
+
+			for( size_t i = 0 ; i < sorted.size() ; ++i ) {
+				compileRule( firstChild + i, *sorted[ i ] );
+			}
+		}
+
+		void compileRule( size_t index, const Node &declaration ) {
+			Rule rule;
+			rule.key = declaration.content;
+
+			bool hasType = false;
+			const Node *keys = nullptr;
+			for( auto property = declaration.cbegin() ; property != declaration.cend() ; ++property ) {
+				if( property->content == "type" ) {
+					const std::string &name = property->value();
+
+					size_t type = 0;
+					while( type <= VT_ANY && name != typeName( ValueType( type ) ) ) {
+						++type;
+					}
+					if( type > VT_ANY ) {
+						property->error( boost::str( boost::format( "unknown type '%s'!" ) % name ) );
+					}
+
+					rule.type = ValueType( type );
+					hasType = true;
+				}
+				else if( property->content == "count" ) {
+					parseRange( *property, rule.minCount, rule.maxCount );
+				}
+				else if( property->content == "values" ) {
+					parseRange( *property, rule.minValues, rule.maxValues );
+				}
+				else if( property->content == "one-of" ) {
+					for( auto value : property->values() ) {
+						rule.allowedValues.push_back( std::string( value ) );
+					}
+				}
+				else if( property->content == "keys" ) {
+					keys = &*property;
+				}
+				else {
+					property->error( boost::str( boost::format( "unknown schema property '%s'!" ) % property->content ) );
+				}
+			}
+
+			if( keys ) {
+				if( hasType && rule.type != VT_MAP ) {
+					keys->error( "only maps can declare keys!" );
+				}
+				rule.type = VT_MAP;
+			}
+
+			rules[ index ] = std::move( rule );
+
+			if( keys ) {
+				compileKeys( index, *keys );
+			}
+		}
+	};
+
+	namespace detail {
+		// where a violation is reported: a node's context or a position in the parsed text
+		struct Location {
+			const LeanTextProcessing::TextContext *context;
+			const LeanTextProcessing::TextContainer *textContainer;
+			LeanTextProcessing::TextPosition position;
+
+			LeanTextProcessing::TextContext get() const {
+				if( context ) {
+					return *context;
+				}
+				return LeanTextProcessing::TextContext( LeanTextProcessing::TextIterator( *textContainer, position ) );
+			}
+
+			Location( const LeanTextProcessing::TextContext &context ) : context( &context ), textContainer( nullptr ) {}
+			Location( const LeanTextProcessing::TextIterator &iterator ) : context( nullptr ), textContainer( &iterator.textContainer ), position( iterator.current ) {}
+		};
+
+		// checks entries against the rule table, one event at a time
+		struct Validator {
+			struct Frame {
+				// rule of the entry (NONE for unchecked entries)
+				size_t rule;
+				Location location;
+				// occurrences of the declared keys are counts[ countsOffset + i ]
+				size_t countsOffset;
+				size_t numValues;
+			};
+
+			const Schema &schema;
+			std::vector< Violation > violations;
+
+			std::vector< Frame > frames;
+			std::vector< size_t > counts;
+
+			const Schema::Rule *rule() const {
+				const size_t index = frames.back().rule;
+				return index != Schema::NONE ? &schema.rules[ index ] : nullptr;
+			}
+
+			bool expectsMap() const {
+				const Schema::Rule *current = rule();
+				return current && current->type == Schema::VT_MAP;
+			}
+
+			void report( const Location &location, const std::string &message ) {
+				violations.push_back( Violation( location.get(), message ) );
+			}
+
+			static std::string describeRange( size_t min, size_t max ) {
+				if( min == max ) {
+					return boost::str( boost::format( "%i" ) % min );
+				}
+				else if( max == Schema::UNBOUNDED ) {
+					return boost::str( boost::format( "at least %i" ) % min );
+				}
+				return boost::str( boost::format( "%i to %i" ) % min % max );
+			}
+
+			void push( size_t rule, const Location &location ) {
+				Frame frame = { rule, location, counts.size(), 0 };
+				frames.push_back( frame );
+
+				if( rule != Schema::NONE && schema.rules[ rule ].type == Schema::VT_MAP ) {
+					counts.resize( counts.size() + schema.rules[ rule ].numChildren, 0 );
+				}
+			}
+
+			void beginEntry( std::string_view key, const Location &location ) {
+				const Schema::Rule *parent = rule();
+				size_t childRule = Schema::NONE;
+
+				if( parent && parent->type == Schema::VT_MAP ) {
+					childRule = schema.find( frames.back().rule, key );
+					if( childRule == Schema::NONE ) {
+						report( location, boost::str( boost::format( "unknown key '%s'!" ) % key ) );
+					}
+					else {
+						const Schema::Rule &child = schema.rules[ childRule ];
+						size_t &count = counts[ frames.back().countsOffset + childRule - parent->firstChild ];
+						if( ++count == child.maxCount + 1 ) {
+							report( location, boost::str( boost::format( "'%s' may appear %s times only!" ) % key % describeRange( child.minCount, child.maxCount ) ) );
+						}
+						if( child.type == Schema::VT_ANY ) {
+							childRule = Schema::NONE;
+						}
+					}
+				}
+				else if( parent ) {
+					report( location, boost::str( boost::format( "expected values, found map entry '%s'!" ) % key ) );
+				}
+
+				push( childRule, location );
+			}
+
+			void value( std::string_view text, const Location &location ) {
+				Frame &frame = frames.back();
+				++frame.numValues;
+
+				const Schema::Rule *current = rule();
+				if( !current ) {
+					return;
+				}
+
+				if( current->type == Schema::VT_MAP ) {
+					if( frame.numValues == 1 ) {
+						report( location, boost::str( boost::format( "expected map, found value '%s'!" ) % text ) );
+					}
+				}
+				else if( !schema.checkValue( *current, text ) ) {
+					if( current->allowedValues.empty() ) {
+						report( location, boost::str( boost::format( "'%s' is not a valid %s!" ) % text % Schema::typeName( current->type ) ) );
+					}
+					else {
+						report( location, boost::str( boost::format( "'%s' is not an allowed value!" ) % text ) );
+					}
+				}
+			}
+
+			void endEntry() {
+				const Frame &frame = frames.back();
+				const Schema::Rule *current = rule();
+
+				if( current && current->type == Schema::VT_MAP ) {
+					for( size_t i = 0 ; i < current->numChildren ; ++i ) {
+						const Schema::Rule &child = schema.rules[ current->firstChild + i ];
+						if( counts[ frame.countsOffset + i ] < child.minCount ) {
+							report( frame.location, boost::str( boost::format( "missing key '%s' (expected %s times)!" ) % child.key % describeRange( child.minCount, child.maxCount ) ) );
+						}
+					}
+				}
+				else if( current && ( frame.numValues < current->minValues || frame.numValues > current->maxValues ) ) {
+					report( frame.location, boost::str( boost::format( "expected %s values for '%s', found %i!" ) % describeRange( current->minValues, current->maxValues ) % current->key % frame.numValues ) );
+				}
+
+				counts.resize( frame.countsOffset );
+				frames.pop_back();
+			}
+
+			Validator( const Schema &schema, const Location &location ) : schema( schema ) {
+				push( 0, location );
+			}
+		};
+
+		// runs a Validator on the parser events
+		struct ValidatingHandler {
+			Validator &validator;
+
+			void beginEntry( std::string &&key, const LeanTextProcessing::TextIterator &position ) {
+				validator.beginEntry( key, Location( position ) );
+			}
+
+			void value( std::string &&value, const LeanTextProcessing::TextIterator &position ) {
+				validator.value( value, Location( position ) );
+			}
+
+			void endEntry( const LeanTextProcessing::TextIterator & ) {
+				validator.endEntry();
+			}
+		};
+
+		// the schema decides whether the children of an entry are values or map entries
+		inline void validateEntries( Validator &validator, const Node &node ) {
+			for( auto entry = node.cbegin() ; entry != node.cend() ; ++entry ) {
+				validator.beginEntry( entry->content, Location( entry->context ) );
+
+				if( validator.expectsMap() ) {
+					validateEntries( validator, *entry );
+				}
+				else {
+					for( size_t i = 0 ; i < entry->size() ; ++i ) {
+						// values must be leaves
+						if( !entry->packed && !entry->nodes[ i ].empty() ) {
+							validator.beginEntry( entry->nodes[ i ].content, Location( entry->nodes[ i ].context ) );
+							validateEntries( validator, entry->nodes[ i ] );
+							validator.endEntry();
+						}
+						else {
+							validator.value( entry->valueAt( i ), Location( entry->packed ? entry->packed->context : entry->nodes[ i ].context ) );
+						}
+					}
+				}
+
+				validator.endEntry();
+			}
+		}
+	}
+
+	inline std::vector< Violation > Schema::validate( const Node &root ) const {
+		detail::Validator validator( *this, detail::Location( root.context ) );
+		detail::validateEntries( validator, root );
+		validator.endEntry();
+		return std::move( validator.violations );
+	}
+
+	inline std::vector< Violation > Schema::validateText( std::string_view content, const std::string &sourceIdentifier ) const {
+		LeanTextProcessing::TextContainer textContainer( content, sourceIdentifier );
+
+		detail::Validator validator( *this, detail::Location( LeanTextProcessing::TextIterator( textContainer, LeanTextProcessing::TextPosition() ) ) );
+		detail::ValidatingHandler handler = { validator };
+
+		detail::Parser< detail::ValidatingHandler > parser( handler, textContainer );
+		parser.parseNode();
+
+		validator.endEntry();
+		return std::move( validator.violations );
+	}
+
+	inline std::vector< Violation > Schema::validateFile( const std::string &filename ) const {
+		std::ifstream file( filename, std::ios_base::binary );
+		const std::string content = std::string( std::istreambuf_iterator<char>( file ), std::istreambuf_iterator<char>() );
+		return validateText( content, filename );
+	}
+}
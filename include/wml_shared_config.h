@@ -0,0 +1,185 @@
+/*
+Copyright 2013 Andreas Kirsch
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "wml.h"
+
+namespace wml {
+	// publishes an immutable parsed tree to many reader threads (RCU-style)
+	//
+	// readers borrow the tree for a scope (read) or take snapshots (snapshot) without locking:
+	// the tree stays valid and unchanged for as long as either is held, and it is only destroyed
+	// after the last snapshot has been released
+	// writers parse outside of any lock and swap the new tree in atomically
+	struct SharedConfig {
+		typedef std::shared_ptr< const Node > Snapshot;
+
+	private:
+		// cache line size (avoids false sharing between readers and writers)
+		static const size_t alignment = 64;
+		// reader threads are spread over this many counters per epoch
+		static const size_t numStripes = 16;
+
+		struct alignas( alignment ) ReaderCount {
+			std::atomic< long > count;
+
+			ReaderCount() : count( 0 ) {}
+		};
+
+		alignas( alignment ) std::atomic< const Snapshot * > current;
+
+		// readers register in the slot of the current epoch while they use the tree
+		// a writer flips the epoch after swapping the tree and waits for the old slot to drain
+		// before it releases its reference to the old tree
+		// every thread has its own counter in each slot (unless there are more threads than stripes),
+		// so concurrent readers don't write to the same cache line
+		alignas( alignment ) std::atomic< unsigned > epoch;
+		mutable ReaderCount readers[2][ numStripes ];
+
+		// only serializes writers
+		std::mutex writerMutex;
+
+		SharedConfig( const SharedConfig & ) = delete;
+		SharedConfig & operator = ( const SharedConfig & ) = delete;
+
+		static size_t readerStripe() {
+			static std::atomic< size_t > nextStripe( 0 );
+			thread_local const size_t stripe = nextStripe++ % numStripes;
+			return stripe;
+		}
+
+		// registers the calling thread as a reader of the current epoch and returns its counter
+		std::atomic< long > &enter() const {
+			const size_t stripe = readerStripe();
+			while( true ) {
+				const unsigned slot = epoch.load();
+				std::atomic< long > &count = readers[ slot & 1 ][ stripe ].count;
+				count.fetch_add( 1 );
+
+				// make sure a writer waits for us if it swaps the tree from now on
+				if( epoch.load() == slot ) {
+					return count;
+				}
+
+				count.fetch_sub( 1 );
+			}
+		}
+
+	public:
+		// borrows the current tree until it is destroyed (see read)
+		struct ReadScope {
+			std::atomic< long > &count;
+			const Node &root;
+
+			const Node & operator * () const {
+				return root;
+			}
+
+			const Node * operator -> () const {
+				return &root;
+			}
+
+			ReadScope( std::atomic< long > &count, const Node &root ) : count( count ), root( root ) {}
+			ReadScope( const ReadScope & ) = delete;
+			ReadScope & operator = ( const ReadScope & ) = delete;
+
+			~ReadScope() {
+				count.fetch_sub( 1 );
+			}
+		};
+
+		// lock-free and without touching shared reference counts (use it for lookups on every request)
+		// writers wait for the scope to end, so keep it short and don't publish while holding one
+		ReadScope read() const {
+			std::atomic< long > &count = enter();
+			return ReadScope( count, **current.load() );
+		}
+
+		// lock-free, for holding a tree across calls (copies a shared_ptr)
+		Snapshot snapshot() const {
+			std::atomic< long > &count = enter();
+			Snapshot snapshot = *current.load();
+			count.fetch_sub( 1 );
+			return snapshot;
+		}
+
+		// number of trees that have been published so far
+		unsigned generation() const {
+			return epoch.load();
+		}
+
+		void publish( Snapshot root ) {
+			const Snapshot *published = new Snapshot( std::move( root ) );
+
+			std::lock_guard< std::mutex > lock( writerMutex );
+
+			const Snapshot *retired = current.exchange( published );
+
+			// new readers use the other slot, so this only waits for readers
+			// that might have seen the retired tree before the swap
+			const unsigned slot = epoch.fetch_add( 1 );
+			for( size_t stripe = 0 ; stripe < numStripes ; ++stripe ) {
+				while( readers[ slot & 1 ][ stripe ].count.load() != 0 ) {
+					std::this_thread::yield();
+				}
+			}
+
+			// the tree itself lives on until the last snapshot of it is released
+			delete retired;
+		}
+
+		void publish( Node &&root ) {
+			publish( std::make_shared< const Node >( std::move( root ) ) );
+		}
+
+		// the current tree is kept if parsing fails
+		void reload( const std::string &content, const std::string &sourceIdentifier = "" ) {
+			publish( parse( content, sourceIdentifier ) );
+		}
+
+		// returns false if the file can't be opened, throws if it can't be parsed
+		// (the current tree is kept in both cases)
+		bool reloadFile( const std::string &filename ) {
+			std::ifstream file( filename, std::ios_base::binary );
+			if( !file.is_open() ) {
+				return false;
+			}
+			publish( parse( file, filename ) );
+			return true;
+		}
+
+		SharedConfig() : current( new Snapshot( std::make_shared< const Node >() ) ), epoch( 0 ) {}
+
+		explicit SharedConfig( Node &&root ) : current( new Snapshot( std::make_shared< const Node >( std::move( root ) ) ) ), epoch( 0 ) {}
+
+		~SharedConfig() {
+			delete current.load();
+		}
+	};
+}
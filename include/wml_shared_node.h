@@ -0,0 +1,342 @@
+/*
+Copyright 2013 Andreas Kirsch
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <atomic>
+
+#include "wml_node.h"
+
+namespace wml {
+	// copy-on-write counterpart of Node
+	//
+	// a SharedNode is a reference-counted handle to an immutable node:
+	// copies share the whole subtree and cost O(1)
+	// non-const access clones the node first if it is shared, so modifying a nested node
+	// only clones the path from the root to it (all other subtrees stay shared)
+	//
+	// note: references obtained through non-const accessors are invalidated by copying
+	// any of their parents (just like with a copy-on-write string)
+	struct SharedNode {
+		typedef std::vector< SharedNode > NodeContainer;
+		typedef NodeContainer::iterator iterator;
+		typedef NodeContainer::const_iterator const_iterator;
+
+	private:
+		struct Data {
+			std::atomic< long > references;
+
+			LeanTextProcessing::TextContext context;
+			std::string content;
+			NodeContainer nodes;
+
+			Data() : references( 1 ) {}
+			Data( const Data &data ) : references( 1 ), context( data.context ), content( data.content ), nodes( data.nodes ) {}
+		};
+
+		// null for empty nodes
+		Data *data;
+
+		static const Data &emptyData() {
+			static const Data empty;
+			return empty;
+		}
+
+		const Data &readData() const {
+			return data ? *data : emptyData();
+		}
+
+		// clone the node if it is shared with another handle
+		Data &writeData() {
+			if( !data ) {
+				data = new Data();
+			}
+			else if( data->references.load( std::memory_order_acquire ) != 1 ) {
+				Data *copy = new Data( *data );
+				release();
+				data = copy;
+			}
+			return *data;
+		}
+
+		void retain() {
+			if( data ) {
+				data->references.fetch_add( 1, std::memory_order_relaxed );
+			}
+		}
+
+		void release() {
+			if( data && data->references.fetch_sub( 1, std::memory_order_acq_rel ) == 1 ) {
+				delete data;
+			}
+			data = nullptr;
+		}
+
+	public:
+		//////////////////////////////////////////////////////////////////////////
+		// read access
+
+		const std::string & key() const {
+			return readData().content;
+		}
+
+		const std::string & value() const {
+			const NodeContainer &nodes = readData().nodes;
+			if( nodes.empty() ) {
+				error( "expected data at node!" );
+			}
+			else if( nodes.size() > 1 ) {
+				error( "expected data at node, found array/map!" );
+			}
+
+			return nodes[0].key();
+		}
+
+		const LeanTextProcessing::TextContext & context() const {
+			return readData().context;
+		}
+
+		const SharedNode & operator[] ( int i ) const {
+			return readData().nodes[ i ];
+		}
+
+		size_t size() const {
+			return readData().nodes.size();
+		}
+
+		bool empty() const {
+			return readData().nodes.empty();
+		}
+
+		const_iterator begin() const {
+			return readData().nodes.cbegin();
+		}
+
+		const_iterator end() const {
+			return readData().nodes.cend();
+		}
+
+		const_iterator cbegin() const {
+			return readData().nodes.cbegin();
+		}
+
+		const_iterator cend() const {
+			return readData().nodes.cend();
+		}
+
+		const_iterator find( std::string_view key ) const {
+			const NodeContainer &nodes = readData().nodes;
+			auto node = nodes.cbegin();
+			for( ; node != nodes.cend() ; ++node ) {
+				if( node->key() == key ) {
+					break;
+				}
+			}
+			return node;
+		}
+
+		const SharedNode & operator[] ( std::string_view key ) const {
+			auto node = find( key );
+			if( node == cend() ) {
+				error( boost::str( boost::format( "key '%s' not found!" ) % key ) );
+			}
+			return *node;
+		}
+
+		template< typename T >
+		T as() const {
+			const std::string &text = value();
+
+			T result = T();
+			if( !Converter< T >::parse( text, result ) ) {
+				readData().nodes[0].error( boost::str( boost::format( "cannot convert '%s' to %s!" ) % text % detail::typeName< T >() ) );
+			}
+			return result;
+		}
+
+		template< typename T >
+		T get( std::string_view key ) const {
+			return (*this)[ key ].as<T>();
+		}
+
+		template< typename T >
+		T getOr( std::string_view key, const T &defaultValue ) const {
+			auto node = find( key );
+
+			if( node != cend() ) {
+				return node->as<T>();
+			}
+
+			return defaultValue;
+		}
+
+		const SharedNode * findPtr( std::string_view key ) const {
+			auto node = find( key );
+			return node != cend() ? &*node : nullptr;
+		}
+
+		template< typename T >
+		std::optional< T > tryGet( std::string_view key ) const {
+			const SharedNode *node = findPtr( key );
+
+			if( node ) {
+				return node->as<T>();
+			}
+
+			return std::nullopt;
+		}
+
+		// true if both handles refer to the same (shared) node
+		bool sharesDataWith( const SharedNode &other ) const {
+			return data == other.data;
+		}
+
+		//////////////////////////////////////////////////////////////////////////
+		// write access (clones shared nodes)
+
+		std::string & key() {
+			return writeData().content;
+		}
+
+		std::string & value() {
+			NodeContainer &nodes = writeData().nodes;
+			if( nodes.empty() ) {
+				error( "expected data at node!" );
+			}
+			else if( nodes.size() > 1 ) {
+				error( "expected data at node, found array/map!" );
+			}
+
+			return nodes[0].key();
+		}
+
+		SharedNode & operator[] ( int i ) {
+			return writeData().nodes[ i ];
+		}
+
+		SharedNode & operator[] ( std::string_view key ) {
+			NodeContainer &nodes = writeData().nodes;
+			for( auto item = nodes.begin() ; item != nodes.end() ; ++item ) {
+				if( item->key() == key ) {
+					return *item;
+				}
+			}
+
+			error( boost::str( boost::format( "key '%s' not found!" ) % key ) );
+		}
+
+		iterator begin() {
+			return writeData().nodes.begin();
+		}
+
+		iterator end() {
+			return writeData().nodes.end();
+		}
+
+		template< typename T >
+		void setValue( const T &newValue ) {
+			NodeContainer &nodes = writeData().nodes;
+			if( nodes.empty() ) {
+				nodes.push_back( SharedNode() );
+			}
+			else if( nodes.size() > 1 ) {
+				error( "expected data at node, found array/map!" );
+			}
+
+			Converter< T >::format( newValue, value() );
+		}
+
+		SharedNode &push_back( const SharedNode &node ) {
+			NodeContainer &nodes = writeData().nodes;
+			nodes.push_back( node );
+			return nodes.back();
+		}
+
+		SharedNode &push_back( const std::string &content ) {
+			return push_back( SharedNode( content ) );
+		}
+
+		SharedNode &push_back( const char *content ) {
+			return push_back( SharedNode( std::string( content ) ) );
+		}
+
+		template< typename T >
+		SharedNode &push_back( const T &content ) {
+			std::string text;
+			Converter< T >::format( content, text );
+			return push_back( SharedNode( text ) );
+		}
+
+		//////////////////////////////////////////////////////////////////////////
+		// conversion from and to Node (deep copies)
+
+		explicit SharedNode( const Node &node ) : data( new Data() ) {
+			data->context = node.context;
+			data->content = node.content;
+			data->nodes.reserve( node.size() );
+			for( auto item = node.cbegin() ; item != node.cend() ; ++item ) {
+				data->nodes.push_back( SharedNode( *item ) );
+			}
+		}
+
+		Node toNode() const {
+			const Data &source = readData();
+
+			Node node( source.content, source.context );
+			node.nodes.reserve( source.nodes.size() );
+			for( auto item = source.nodes.cbegin() ; item != source.nodes.cend() ; ++item ) {
+				node.nodes.push_back( item->toNode() );
+			}
+			return node;
+		}
+
+		SharedNode() : data( nullptr ) {}
+		SharedNode( const std::string &content ) : data( new Data() ) {
+			data->content = content;
+		}
+		SharedNode( const std::string &content, const LeanTextProcessing::TextContext &context ) : data( new Data() ) {
+			data->content = content;
+			data->context = context;
+		}
+
+		SharedNode( const SharedNode &node ) : data( node.data ) {
+			retain();
+		}
+
+		SharedNode( SharedNode &&node ) noexcept : data( node.data ) {
+			node.data = nullptr;
+		}
+
+		SharedNode & operator = ( SharedNode node ) {
+			std::swap( data, node.data );
+			return *this;
+		}
+
+		~SharedNode() {
+			release();
+		}
+
+		[[noreturn]] void error( const std::string &message ) const {
+			throw LeanTextProcessing::TextException( context(), message );
+		}
+	};
+}
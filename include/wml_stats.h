@@ -0,0 +1,158 @@
+/*
+Copyright 2013 Andreas Kirsch
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace wml {
+	// what parse and emit calls did (see the overloads that take a Stats pointer)
+	// the counters are added to, so one Stats can cover several calls
+	struct Stats {
+		// length of the WML text
+		size_t bytes;
+		// keys and values
+		size_t nodes;
+		// depth of the deepest node (entries of the root have depth 1)
+		size_t maxDepth;
+		// most children of a single node
+		size_t maxFanOut;
+		// keys and values in double quotes
+		size_t escapedStrings;
+		size_t textBlocks;
+
+		// in seconds
+		double readTime;
+		double parseTime;
+		double emitTime;
+
+		// only counted if the program reports its allocations through countAllocation
+		// (see WML_DEFINE_COUNTING_OPERATOR_NEW)
+		size_t allocations;
+		size_t allocatedBytes;
+
+		Stats() : bytes( 0 ), nodes( 0 ), maxDepth( 0 ), maxFanOut( 0 ), escapedStrings( 0 ), textBlocks( 0 ), readTime( 0.0 ), parseTime( 0.0 ), emitTime( 0.0 ), allocations( 0 ), allocatedBytes( 0 ) {}
+	};
+
+	namespace detail {
+		struct AllocationCounters {
+			size_t allocations;
+			size_t bytes;
+		};
+
+		inline AllocationCounters &allocationCounters() {
+			thread_local AllocationCounters counters = { 0, 0 };
+			return counters;
+		}
+
+		// measures one phase and adds its allocations to the stats (does nothing without stats)
+		struct StatsScope {
+			typedef std::chrono::steady_clock Clock;
+
+			Stats *stats;
+			double *time;
+			Clock::time_point start;
+			AllocationCounters counters;
+
+			StatsScope( Stats *stats, double Stats::*time ) : stats( stats ), time( stats ? &(stats->*time) : nullptr ), counters() {
+				if( stats ) {
+					counters = allocationCounters();
+					start = Clock::now();
+				}
+			}
+
+			~StatsScope() {
+				if( stats ) {
+					*time += std::chrono::duration< double >( Clock::now() - start ).count();
+					stats->allocations += allocationCounters().allocations - counters.allocations;
+					stats->allocatedBytes += allocationCounters().bytes - counters.bytes;
+				}
+			}
+		};
+
+		template< typename Node >
+		void measureTree( const Node &node, size_t depth, Stats &stats ) {
+			stats.nodes += node.size();
+			if( !node.empty() ) {
+				stats.maxDepth = std::max( stats.maxDepth, depth + 1 );
+			}
+			stats.maxFanOut = std::max( stats.maxFanOut, node.size() );
+
+			if( node.packed ) {
+				return;
+			}
+			for( auto child = node.nodes.cbegin() ; child != node.nodes.cend() ; ++child ) {
+				measureTree( *child, depth + 1, stats );
+			}
+		}
+	}
+
+	// call this from a replacement operator new to have allocations show up in Stats
+	inline void countAllocation( size_t size ) {
+		detail::AllocationCounters &counters = detail::allocationCounters();
+		++counters.allocations;
+		counters.bytes += size;
+	}
+
+	namespace detail {
+		// the replaced operator new and delete go through these two (see WML_DEFINE_COUNTING_OPERATOR_NEW),
+		// so every delete overload pairs with the same allocation function
+		inline void *allocateCounted( size_t size ) {
+			countAllocation( size );
+			if( void *memory = std::malloc( size ? size : 1 ) ) {
+				return memory;
+			}
+			throw std::bad_alloc();
+		}
+
+		inline void freeCounted( void *memory ) noexcept {
+			std::free( memory );
+		}
+	}
+}
+
+// defines the global operator new and delete with allocation counting (use it in exactly one source file)
+// the nothrow forms end up here too, but the aligned forms (std::align_val_t) aren't replaced,
+// so allocations of over-aligned types aren't counted
+#define WML_DEFINE_COUNTING_OPERATOR_NEW \
+	void * operator new( size_t size ) { \
+		return wml::detail::allocateCounted( size ); \
+	} \
+	void * operator new[]( size_t size ) { \
+		return wml::detail::allocateCounted( size ); \
+	} \
+	void operator delete( void *memory ) noexcept { \
+		wml::detail::freeCounted( memory ); \
+	} \
+	void operator delete[]( void *memory ) noexcept { \
+		wml::detail::freeCounted( memory ); \
+	} \
+	void operator delete( void *memory, size_t ) noexcept { \
+		wml::detail::freeCounted( memory ); \
+	} \
+	void operator delete[]( void *memory, size_t ) noexcept { \
+		wml::detail::freeCounted( memory ); \
+	}
@@ -0,0 +1,196 @@
+/*
+Copyright 2013 Andreas Kirsch
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+// optional instrumentation of the parser, the emitter and the file functions
+//
+// define WML_TRACE (for the whole program) to enable it, otherwise the trace points compile to nothing
+// the events go to a hook (see setTraceHook), ChromeTrace collects them and writes
+// Chrome trace-event JSON (for chrome://tracing or Perfetto)
+//
+// trace points:
+//	parse, emit, emitPreserving		whole calls
+//	read, emitFile					reading streams and files, writing files
+//	parseMap, emitMap				maps up to WML_TRACE_DEPTH levels deep
+//	parseTextBlock					text blocks
+//	emitPart						parts of emitParallel
+// events carry the source line of the entry (or 0) and the number of bytes that were parsed or emitted
+// (parse, parseMap, parseTextBlock and emit into a string, 0 for the others)
+
+#ifndef WML_TRACE_DEPTH
+#	define WML_TRACE_DEPTH 2
+#endif
+
+#ifdef WML_TRACE
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+namespace wml {
+	struct TraceEvent {
+		// a string literal
+		const char *name;
+		// line of the entry in the source (or 0)
+		int line;
+		// microseconds since the first event of the program
+		double start;
+		double duration;
+		std::thread::id thread;
+		// size of the parsed or emitted text (or 0)
+		size_t bytes;
+	};
+
+	typedef std::function< void ( const TraceEvent &event ) > TraceHook;
+
+	namespace detail {
+		inline TraceHook &traceHook() {
+			static TraceHook hook;
+			return hook;
+		}
+
+		inline double traceTime() {
+			typedef std::chrono::steady_clock Clock;
+			static const Clock::time_point epoch = Clock::now();
+			return std::chrono::duration< double, std::micro >( Clock::now() - epoch ).count();
+		}
+
+		// reports the time between construction and destruction to the hook
+		struct TraceScope {
+			const char *name;
+			int line;
+			double start;
+			bool isActive;
+			size_t bytes;
+
+			TraceScope( const char *name, int line, bool condition, size_t bytes = 0 ) : name( name ), line( line ), start( 0.0 ), isActive( condition && traceHook() ), bytes( bytes ) {
+				if( isActive ) {
+					start = traceTime();
+				}
+			}
+
+			~TraceScope() {
+				if( isActive ) {
+					const TraceEvent event = { name, line, start, traceTime() - start, std::this_thread::get_id(), bytes };
+					traceHook()( event );
+				}
+			}
+		};
+
+		// also reports how far position() (an index into the text) has moved in the scope
+		template< typename Position >
+		struct TraceRangeScope : TraceScope {
+			Position position;
+			size_t startPosition;
+
+			TraceRangeScope( const char *name, int line, bool condition, Position position ) : TraceScope( name, line, condition ), position( position ), startPosition( isActive ? position() : 0 ) {}
+
+			~TraceRangeScope() {
+				if( isActive ) {
+					bytes = position() - startPosition;
+				}
+			}
+		};
+	}
+
+	// the hook is called from the threads that parse and emit
+	// set it before they start (an empty hook disables tracing)
+	inline void setTraceHook( const TraceHook &hook ) {
+		detail::traceHook() = hook;
+	}
+
+	// collects events while it exists
+	struct ChromeTrace {
+		std::mutex mutex;
+		std::vector< TraceEvent > events;
+
+		void write( std::ostream &stream ) {
+			std::lock_guard< std::mutex > lock( mutex );
+
+			// small ids for the threads
+			std::vector< std::thread::id > threads;
+
+			const std::ios_base::fmtflags flags = stream.flags();
+			const std::streamsize precision = stream.precision();
+			stream << std::fixed << std::setprecision( 3 );
+
+			stream << "{\"traceEvents\":[";
+			for( auto event = events.cbegin() ; event != events.cend() ; ++event ) {
+				const size_t thread = std::find( threads.begin(), threads.end(), event->thread ) - threads.begin();
+				if( thread == threads.size() ) {
+					threads.push_back( event->thread );
+				}
+
+				if( event != events.cbegin() ) {
+					stream << ",";
+				}
+				// names are literals without special characters
+				stream << "\n{\"name\":\"" << event->name << "\",\"cat\":\"wml\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread
+					<< ",\"ts\":" << event->start << ",\"dur\":" << event->duration << ",\"args\":{\"line\":" << event->line;
+				if( event->bytes ) {
+					stream << ",\"bytes\":" << event->bytes;
+				}
+				stream << "}}";
+			}
+			stream << "\n]}\n";
+
+			stream.flags( flags );
+			stream.precision( precision );
+		}
+
+		ChromeTrace() {
+			setTraceHook( [this] ( const TraceEvent &event ) {
+				std::lock_guard< std::mutex > lock( mutex );
+				events.push_back( event );
+			} );
+		}
+
+		~ChromeTrace() {
+			setTraceHook( TraceHook() );
+		}
+
+		ChromeTrace( const ChromeTrace & ) = delete;
+		ChromeTrace & operator = ( const ChromeTrace & ) = delete;
+	};
+}
+
+#	define WML_TRACE_CONCAT_( a, b ) a##b
+#	define WML_TRACE_CONCAT( a, b ) WML_TRACE_CONCAT_( a, b )
+#	define WML_TRACE_SCOPE( name, line ) wml::detail::TraceScope WML_TRACE_CONCAT( wmlTraceScope, __LINE__ )( name, line, true )
+#	define WML_TRACE_SCOPE_IF( condition, name, line ) wml::detail::TraceScope WML_TRACE_CONCAT( wmlTraceScope, __LINE__ )( name, line, condition )
+// bytes is known up front
+#	define WML_TRACE_SIZED_SCOPE( name, line, bytes ) wml::detail::TraceScope WML_TRACE_CONCAT( wmlTraceScope, __LINE__ )( name, line, true, bytes )
+// position is evaluated at the beginning and the end of the scope
+#	define WML_TRACE_RANGE_SCOPE_IF( condition, name, line, position ) \
+		wml::detail::TraceRangeScope WML_TRACE_CONCAT( wmlTraceScope, __LINE__ )( name, line, condition, [&] () { return size_t( position ); } )
+#else
+#	define WML_TRACE_SCOPE( name, line )
+#	define WML_TRACE_SCOPE_IF( condition, name, line )
+#	define WML_TRACE_SIZED_SCOPE( name, line, bytes )
+#	define WML_TRACE_RANGE_SCOPE_IF( condition, name, line, position )
+#endif
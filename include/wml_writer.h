@@ -0,0 +1,210 @@
+/*
+Copyright 2013 Andreas Kirsch
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <cassert>
+#include <ostream>
+
+#include "wml.h"
+
+namespace wml {
+	// writes WML directly to a sink, without building a Node tree first
+	// values are quoted like emit does, so the text parses back to the described tree
+	//
+	//	Writer writer( stream );
+	//	writer.beginMap( "server" );
+	//	writer.entry( "host", "localhost" );
+	//	writer.entry( "ports", 80, 8080 );
+	//	writer.textBlock( "motd", "hello\nworld\n" );
+	//	writer.endMap();
+	//	writer.finish();
+	//
+	// maps are written once they have an entry (an empty map is written as a key without values,
+	// like emit does), nesting errors are caught by asserts
+	struct Writer {
+		typedef detail::BufferedOutput::Write Write;
+
+		detail::BufferedOutput output;
+		detail::Emitter< detail::BufferedOutput > emitter;
+
+		// maps that have been begun but not ended
+		int openMaps;
+		// key of the innermost map if it hasn't been written yet
+		std::string pendingKey;
+		bool hasPendingMap;
+		bool isFinished;
+
+		// conversion buffer for non-string values
+		std::string converted;
+
+		void beginMap( std::string_view key ) {
+			assert( !isFinished );
+
+			writePendingMap();
+
+			pendingKey.assign( key.data(), key.size() );
+			hasPendingMap = true;
+			++openMaps;
+		}
+
+		void endMap() {
+			assert( openMaps > 0 && "endMap without beginMap" );
+
+			if( hasPendingMap ) {
+				hasPendingMap = false;
+				writeKey( pendingKey );
+				output.push_back( '\n' );
+			}
+			else {
+				--emitter.indentLevel;
+			}
+			--openMaps;
+		}
+
+		// an entry with inline values (converted with Converter)
+		template< typename... Values >
+		void entry( std::string_view key, const Values &... values ) {
+			writeKey( key );
+
+			if constexpr( sizeof...( Values ) == 1 ) {
+				writeSingleValue( values... );
+			}
+			else {
+				( writeInlineValue( values ), ... );
+				output.push_back( '\n' );
+			}
+		}
+
+		// an entry with the values of a range
+		template< typename Range >
+		void entryValues( std::string_view key, const Range &values ) {
+			writeKey( key );
+			for( const auto &value : values ) {
+				writeInlineValue( value );
+			}
+			output.push_back( '\n' );
+		}
+
+		void textBlock( std::string_view key, std::string_view text ) {
+			writeKey( key );
+
+			// text blocks can't contain \r or \0
+			if( text.find_first_of( std::string_view( "\r\0", 2 ) ) != std::string_view::npos ) {
+				output.push_back( ' ' );
+				emitter.emitValue( text, emitter.VT_ESCAPED_STRING );
+				output.push_back( '\n' );
+			}
+			else {
+				emitter.emitTextBlock( text );
+			}
+		}
+
+		void flush() {
+			output.flush();
+		}
+
+		// checks that all maps have been ended and flushes
+		void finish() {
+			assert( openMaps == 0 && "unterminated map" );
+			assert( !hasPendingMap );
+
+			flush();
+			isFinished = true;
+		}
+
+		Writer( const Write &write, size_t bufferSize = 64 * 1024 ) : output( write, bufferSize ), emitter( output ), openMaps( 0 ), hasPendingMap( false ), isFinished( false ) {}
+		Writer( std::ostream &stream, size_t bufferSize = 64 * 1024 ) : Writer( [&stream] ( const char *data, size_t size ) { stream.write( data, size ); }, bufferSize ) {}
+
+		// flushes the rest (use finish to notice errors)
+		~Writer() {
+			if( !isFinished ) {
+				try {
+					flush();
+				}
+				catch( ... ) {
+				}
+			}
+		}
+
+	private:
+		Writer( const Writer & );
+		Writer & operator = ( const Writer & );
+
+		void writePendingMap() {
+			if( hasPendingMap ) {
+				emitter.emitMapHeader( pendingKey );
+				++emitter.indentLevel;
+				hasPendingMap = false;
+			}
+		}
+
+		void writeKey( std::string_view key ) {
+			assert( !isFinished );
+
+			writePendingMap();
+
+			emitter.emitTabs();
+			emitter.emitValue( key, true );
+		}
+
+		std::string_view toText( std::string_view value ) {
+			return value;
+		}
+
+		std::string_view toText( const std::string &value ) {
+			return value;
+		}
+
+		std::string_view toText( const char *value ) {
+			return value;
+		}
+
+		template< typename T >
+		std::string_view toText( const T &value ) {
+			Converter< T >::format( value, converted );
+			return converted;
+		}
+
+		template< typename T >
+		void writeInlineValue( const T &value ) {
+			output.push_back( ' ' );
+			emitter.emitValue( toText( value ), true );
+		}
+
+		// like emit: single values with several lines become text blocks
+		template< typename T >
+		void writeSingleValue( const T &value ) {
+			const std::string_view text = toText( value );
+			const auto vt = emitter.determineType( text );
+
+			if( vt == emitter.VT_TEXT ) {
+				emitter.emitValue( text, vt );
+			}
+			else {
+				output.push_back( ' ' );
+				emitter.emitValue( text, vt );
+				output.push_back( '\n' );
+			}
+		}
+	};
+}
@@ -0,0 +1,382 @@
+/*
+Copyright 2013 Andreas Kirsch
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+// benchmarks for parsing, emitting and accessing trees
+//
+// usage: benchmark [--sizes 1K,1M,64M] [--seed n] [--shape name] [--minTime seconds]
+//
+// the documents are generated from a seed, so results are comparable between runs and machines
+// throughput is reported in MB/s (of the WML text) and nodes/s
+#include "wml.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <random>
+
+namespace {
+	//////////////////////////////////////////////////////////////////////////
+	// corpus generator
+
+	enum Shape {
+		// maps nested 64 levels deep
+		S_DEEP,
+		// maps with thousands of entries
+		S_WIDE,
+		// long inline lists of numbers
+		S_LISTS,
+		// mostly text blocks
+		S_TEXT_BLOCKS,
+		// a mix of everything with \r\n newlines
+		S_CRLF,
+		S_COUNT
+	};
+
+	const char *shapeNames[ S_COUNT ] = { "deep", "wide", "lists", "textBlocks", "crlf" };
+
+	struct Generator {
+		std::mt19937 random;
+		std::string text;
+		const char *newline;
+
+		void indent( int level ) {
+			text.append( level, '\t' );
+		}
+
+		void line( int level, const std::string &content ) {
+			indent( level );
+			text += content;
+			text += newline;
+		}
+
+		std::string word() {
+			static const char *words[] = { "alpha", "beta", "gamma", "delta", "epsilon", "'quoted text'", "\"with\\ttab\"", "x:y" };
+			return words[ random() % ( sizeof( words ) / sizeof( *words ) ) ];
+		}
+
+		std::string number() {
+			if( random() % 2 ) {
+				return std::to_string( int( random() % 100000 ) - 50000 );
+			}
+			return std::to_string( std::uniform_real_distribution< double >( -1000.0, 1000.0 )( random ) );
+		}
+
+		// a small record that uses the keys the conversion benchmark looks for
+		void record( int level ) {
+			line( level, "name " + word() );
+			line( level, "count " + std::to_string( random() % 1000 ) );
+			line( level, "ratio " + std::to_string( std::uniform_real_distribution< double >( 0.0, 1.0 )( random ) ) );
+		}
+
+		void deep() {
+			const int depth = 64;
+			for( int level = 0 ; level < depth ; ++level ) {
+				line( level, "level" + std::to_string( level ) + ":" );
+				record( level + 1 );
+			}
+		}
+
+		void wide() {
+			line( 0, "items:" );
+			for( int i = 0 ; i < 4096 ; ++i ) {
+				line( 1, "key" + std::to_string( i ) + " " + word() );
+			}
+			record( 0 );
+		}
+
+		void lists() {
+			std::string values = "values";
+			const int count = 16 + random() % 240;
+			for( int i = 0 ; i < count ; ++i ) {
+				values += ' ';
+				values += number();
+			}
+			line( 0, values );
+			record( 0 );
+		}
+
+		void textBlocks() {
+			line( 0, "text::" );
+			const int count = 1 + random() % 32;
+			for( int i = 0 ; i < count ; ++i ) {
+				line( 1, word() + " " + word() + " " + number() + " # " + word() );
+			}
+			record( 0 );
+		}
+
+		void generate( Shape shape, size_t size ) {
+			while( text.size() < size ) {
+				switch( shape ) {
+				case S_DEEP:
+					deep();
+					break;
+				case S_WIDE:
+					wide();
+					break;
+				case S_LISTS:
+					lists();
+					break;
+				case S_TEXT_BLOCKS:
+					textBlocks();
+					break;
+				case S_CRLF:
+					line( 0, "entry:" );
+					record( 1 );
+					switch( random() % 3 ) {
+					case 0:
+						line( 1, "list " + number() + " " + number() + " " + word() );
+						break;
+					case 1:
+						line( 1, "text::" );
+						line( 2, word() + " " + word() );
+						break;
+					default:
+						line( 1, "nested:" );
+						record( 2 );
+					}
+					break;
+				default:
+					return;
+				}
+			}
+		}
+
+		Generator( unsigned seed, Shape shape ) : random( seed ), newline( shape == S_CRLF ? "\r\n" : "\n" ) {}
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+	// harness
+
+	typedef std::chrono::steady_clock Clock;
+
+	struct Options {
+		std::vector< size_t > sizes;
+		unsigned seed;
+		std::string shape;
+		double minTime;
+
+		Options() : seed( 1 ), minTime( 0.5 ) {}
+	};
+
+	// keeps the optimizer from removing the benchmarked code
+	volatile size_t sink;
+
+	// runs f until minTime has passed (at least 3 times) and returns the fastest run in seconds
+	// setup runs before every iteration and isn't measured
+	double measure( double minTime, const std::function< void() > &f, const std::function< void() > &setup = std::function< void() >() ) {
+		double best = 1e100, total = 0.0;
+		for( int iteration = 0 ; iteration < 3 || total < minTime ; ++iteration ) {
+			if( setup ) {
+				setup();
+			}
+			const Clock::time_point start = Clock::now();
+			f();
+			const double seconds = std::chrono::duration< double >( Clock::now() - start ).count();
+			best = std::min( best, seconds );
+			total += seconds;
+		}
+		return best;
+	}
+
+	void report( const char *shape, size_t size, const char *benchmark, double seconds, size_t bytes, size_t nodes ) {
+		std::printf( "%-12s %12zu  %-12s %10.3f ms %10.1f MB/s %12.0f nodes/s\n",
+			shape, size, benchmark, seconds * 1e3, bytes / seconds / ( 1024.0 * 1024.0 ), nodes / seconds );
+		std::fflush( stdout );
+	}
+
+	size_t countNodes( const wml::Node &node ) {
+		size_t count = node.size();
+		if( !node.packed ) {
+			for( auto child = node.cbegin() ; child != node.cend() ; ++child ) {
+				count += countNodes( *child );
+			}
+		}
+		return count;
+	}
+
+	// looks up every key of every map
+	size_t lookupKeys( const wml::Node &node ) {
+		size_t found = 0;
+		if( node.packed ) {
+			return found;
+		}
+		for( auto child = node.cbegin() ; child != node.cend() ; ++child ) {
+			if( !child->empty() ) {
+				found += node.find( child->key() ) != node.cend();
+				found += lookupKeys( *child );
+			}
+		}
+		return found;
+	}
+
+	// converts the values of all known keys (see Generator::record)
+	double convertValues( const wml::Node &node ) {
+		double sum = 0.0;
+		if( node.packed ) {
+			return sum;
+		}
+		for( auto child = node.cbegin() ; child != node.cend() ; ++child ) {
+			const std::string &key = child->key();
+			if( key == "count" ) {
+				sum += child->as< int >();
+			}
+			else if( key == "ratio" ) {
+				sum += child->as< double >();
+			}
+			else if( key == "values" ) {
+				const std::vector< double > values = child->asArray< double >();
+				for( auto value = values.cbegin() ; value != values.cend() ; ++value ) {
+					sum += *value;
+				}
+			}
+			else {
+				sum += convertValues( *child );
+			}
+		}
+		return sum;
+	}
+
+	void run( Shape shape, size_t size, const Options &options ) {
+		Generator generator( options.seed, shape );
+		generator.generate( shape, size );
+		const std::string &text = generator.text;
+		const char *name = shapeNames[ shape ];
+
+		wml::Node root = wml::parse( text );
+		const size_t nodes = countNodes( root );
+		const std::string emitted = wml::emit( root );
+
+		report( name, text.size(), "parse", measure( options.minTime, [&] () {
+			wml::Node parsed = wml::parse( text );
+			sink = parsed.size();
+		} ), text.size(), nodes );
+
+		report( name, text.size(), "emit", measure( options.minTime, [&] () {
+			sink = wml::emit( root ).size();
+		} ), emitted.size(), nodes );
+
+		report( name, text.size(), "roundTrip", measure( options.minTime, [&] () {
+			sink = wml::emit( wml::parse( text ) ).size();
+		} ), text.size(), nodes );
+
+		report( name, text.size(), "lookup", measure( options.minTime, [&] () {
+			sink = lookupKeys( root );
+		} ), text.size(), nodes );
+
+		report( name, text.size(), "as<T>", measure( options.minTime, [&] () {
+			sink = size_t( convertValues( root ) );
+		} ), text.size(), nodes );
+
+		wml::Node copy;
+		report( name, text.size(), "copy", measure( options.minTime, [&] () {
+			copy = root;
+		}, [&] () {
+			copy = wml::Node();
+		} ), text.size(), nodes );
+
+		report( name, text.size(), "destroy", measure( options.minTime, [&] () {
+			copy = wml::Node();
+		}, [&] () {
+			copy = root;
+		} ), text.size(), nodes );
+	}
+
+	size_t parseSize( const std::string &text ) {
+		char *suffix;
+		size_t size = std::strtoull( text.c_str(), &suffix, 10 );
+		switch( *suffix ) {
+		case 'K': case 'k':
+			return size << 10;
+		case 'M': case 'm':
+			return size << 20;
+		case 'G': case 'g':
+			return size << 30;
+		default:
+			return size;
+		}
+	}
+
+	bool parseOptions( int argc, char **argv, Options &options ) {
+		for( int i = 1 ; i < argc ; ++i ) {
+			const std::string argument = argv[ i ];
+			if( i + 1 == argc ) {
+				return false;
+			}
+			const std::string value = argv[ ++i ];
+
+			if( argument == "--sizes" ) {
+				options.sizes.clear();
+				for( size_t begin = 0 ; begin <= value.size() ; ) {
+					size_t end = value.find( ',', begin );
+					if( end == std::string::npos ) {
+						end = value.size();
+					}
+					options.sizes.push_back( parseSize( value.substr( begin, end - begin ) ) );
+					begin = end + 1;
+				}
+			}
+			else if( argument == "--seed" ) {
+				options.seed = unsigned( std::strtoul( value.c_str(), nullptr, 10 ) );
+			}
+			else if( argument == "--shape" ) {
+				options.shape = value;
+			}
+			else if( argument == "--minTime" ) {
+				options.minTime = std::strtod( value.c_str(), nullptr );
+			}
+			else {
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+int main( int argc, char **argv ) {
+	Options options;
+	options.sizes.push_back( 1 << 10 );
+	options.sizes.push_back( 1 << 20 );
+	options.sizes.push_back( 64 << 20 );
+
+	if( !parseOptions( argc, argv, options ) ) {
+		std::cerr << "usage: benchmark [--sizes 1K,1M,64M,1G] [--seed n] [--shape deep|wide|lists|textBlocks|crlf] [--minTime seconds]" << std::endl;
+		return 1;
+	}
+
+	try {
+		for( int shape = 0 ; shape < S_COUNT ; ++shape ) {
+			if( !options.shape.empty() && options.shape != shapeNames[ shape ] ) {
+				continue;
+			}
+			for( auto size = options.sizes.cbegin() ; size != options.sizes.cend() ; ++size ) {
+				run( Shape( shape ), *size, options );
+			}
+		}
+	}
+	catch( std::exception &e ) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,143 @@
+/*
+Copyright 2013 Andreas Kirsch
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include "gtest.h"
+
+#include "wml_binding.h"
+
+using namespace wml;
+
+struct Vertex {
+	float x, y, z;
+};
+
+struct Mesh {
+	std::string name;
+	std::vector< float > weights;
+	std::optional< int > lod;
+	std::vector< Vertex > vertices;
+	Vertex origin;
+	std::vector< std::string > tags;
+};
+
+template<>
+struct wml::Binding< Vertex > {
+	static constexpr auto fields = std::make_tuple(
+		WML_FIELD( Vertex, x ),
+		WML_FIELD( Vertex, y ),
+		WML_FIELD( Vertex, z )
+	);
+};
+
+template<>
+struct wml::Binding< Mesh > {
+	static constexpr auto fields = std::make_tuple(
+		WML_FIELD( Mesh, name ),
+		WML_FIELD( Mesh, weights ),
+		wml::field( "level-of-detail", &Mesh::lod ),
+		wml::field( "vertex", &Mesh::vertices ),
+		WML_FIELD( Mesh, origin ),
+		WML_FIELD( Mesh, tags )
+	);
+};
+
+static const char *meshText =
+	"name 'a mesh'\n"
+	"weights 0.5 0.25\n"
+	"weights 0.125\n"
+	"vertex:\n"
+	"\tx 1\n"
+	"\ty 2\n"
+	"\tz 3\n"
+	"origin:\n"
+	"\tz 0\n"
+	"\ty -1\n"
+	"\tx 0\n"
+	"vertex:\n"
+	"\tx 4\n"
+	"\ty 5\n"
+	"\tz 6\n";
+
+TEST( Binding, perfectHash ) {
+	constexpr detail::PerfectHash< 3 > hash( std::array< std::string_view, 3 >{ { "x", "y", "z" } } );
+	static_assert( hash.find( "y" ) == 1, "perfect hash lookup" );
+
+	ASSERT_EQ( 0, hash.find( "x" ) );
+	ASSERT_EQ( 2, hash.find( "z" ) );
+	ASSERT_EQ( hash.NONE, hash.find( "w" ) );
+	ASSERT_EQ( hash.NONE, hash.find( "" ) );
+}
+
+TEST( Binding, parseAs ) {
+	Mesh mesh = parseAs< Mesh >( meshText );
+
+	ASSERT_EQ( "a mesh", mesh.name );
+	ASSERT_EQ( 3, mesh.weights.size() );
+	ASSERT_EQ( 0.125f, mesh.weights[2] );
+	ASSERT_FALSE( mesh.lod );
+	ASSERT_EQ( 2, mesh.vertices.size() );
+	ASSERT_EQ( 3.0f, mesh.vertices[0].z );
+	ASSERT_EQ( 4.0f, mesh.vertices[1].x );
+	ASSERT_EQ( -1.0f, mesh.origin.y );
+	ASSERT_TRUE( mesh.tags.empty() );
+
+	mesh = parseAs< Mesh >( std::string( meshText ) + "level-of-detail 2\ntags a b\ntags c\n" );
+	ASSERT_EQ( 2, *mesh.lod );
+	ASSERT_EQ( 3, mesh.tags.size() );
+	ASSERT_EQ( "c", mesh.tags[2] );
+}
+
+TEST( Binding, errors ) {
+	const std::string text = meshText;
+
+	// unknown key
+	ASSERT_THROW( parseAs< Mesh >( text + "color red\n" ), LeanTextProcessing::TextException );
+	// duplicate key
+	ASSERT_THROW( parseAs< Mesh >( text + "name other\n" ), LeanTextProcessing::TextException );
+	// missing key
+	ASSERT_THROW( parseAs< Mesh >( "name mesh\norigin:\n\tx 1\n\ty 1\n" ), LeanTextProcessing::TextException );
+	// conversion
+	ASSERT_THROW( parseAs< Mesh >( text + "level-of-detail high\n" ), LeanTextProcessing::TextException );
+	// too many values
+	ASSERT_THROW( parseAs< Mesh >( text + "level-of-detail 1 2\n" ), LeanTextProcessing::TextException );
+	// map instead of value and the other way around
+	ASSERT_THROW( parseAs< Mesh >( text + "level-of-detail:\n\tx 1\n" ), LeanTextProcessing::TextException );
+	ASSERT_THROW( parseAs< Mesh >( text + "vertex 1 2 3\n" ), LeanTextProcessing::TextException );
+
+	// errors point at the entry
+	try {
+		parseAs< Mesh >( "name mesh\norigin:\n\tx 1\n\ty 1\n" );
+	}
+	catch( const LeanTextProcessing::TextException &exception ) {
+		ASSERT_EQ( 2, exception.context.position.line );
+		ASSERT_NE( std::string::npos, exception.error.find( "'z'" ) );
+	}
+}
+
+TEST( Binding, sameAsNodeTree ) {
+	Node root = parse( meshText );
+	Mesh mesh = parseAs< Mesh >( meshText );
+
+	ASSERT_EQ( root.get< std::string >( "name" ), mesh.name );
+	ASSERT_EQ( root[ "origin" ].get< float >( "y" ), mesh.origin.y );
+	ASSERT_EQ( root.getNodes( "vertex" ).size(), mesh.vertices.size() );
+}
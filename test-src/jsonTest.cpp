@@ -0,0 +1,125 @@
+/*
+Copyright 2013 Andreas Kirsch
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include "gtest.h"
+
+#include "wml_json.h"
+
+#include <sstream>
+
+using namespace wml;
+
+namespace {
+	std::string toJson( const std::string &wml ) {
+		std::ostringstream json;
+		wmlToJson( wml, json );
+		return json.str();
+	}
+
+	std::string toWml( const std::string &json ) {
+		std::istringstream input( json );
+		std::ostringstream wml;
+		jsonToWml( input, wml );
+		return wml.str();
+	}
+}
+
+TEST( Json, wmlToJson ) {
+	ASSERT_EQ( "{}\n", toJson( "" ) );
+	ASSERT_EQ(
+		"{\"title\":\"main\\twindow\",\"size\":[\"10\",\"20\"],\"window\":{\"flag\":null,\"text\":\"line 1\\nline 2\"},"
+		"\"stream\":{\"a\":\"1\"},\"stream\":{\"a\":\"2\"},\"control\":\"\\u0000\"}\n",
+		toJson(
+			"title \"main\\twindow\"\n"
+			"size 10 20\n"
+			"window:\n"
+			"\tflag\n"
+			"\ttext::\n"
+			"\t\tline 1\n"
+			"\t\tline 2\n"
+			"stream:\n"
+			"\ta 1\n"
+			"stream:\n"
+			"\ta 2\n"
+			"control \"\\0\"\n"
+		)
+	);
+}
+
+TEST( Json, jsonToWml ) {
+	ASSERT_EQ( "", toWml( " { } " ) );
+	ASSERT_EQ(
+		"a 1 2\n"
+		"a:\n"
+		"\tb true\n"
+		"a 3 4\n"
+		"a\n"
+		"a 5\n"
+		"n\n"
+		"e\n"
+		"z\n"
+		"s 'a b'\n"
+		"u \"\xc3\xa9\\n\"\n",
+		toWml( "{ \"a\": [ 1, 2, { \"b\": true }, [ 3, 4 ], null, 5 ], \"n\": null, \"e\": {}, \"z\": [], \"s\": \"a b\", \"u\": \"\\u00e9\\n\" }" )
+	);
+
+	ASSERT_THROW( toWml( "[]" ), LeanTextProcessing::TextException );
+	ASSERT_THROW( toWml( "{ \"a\": tru }" ), LeanTextProcessing::TextException );
+	ASSERT_THROW( toWml( "{ \"a\": \"x\"" ), LeanTextProcessing::TextException );
+	ASSERT_THROW( toWml( "{} {}" ), LeanTextProcessing::TextException );
+}
+
+TEST( Json, jsonToWml_validation ) {
+	ASSERT_EQ( "n 0 -1 1.5 -0.25e3 2E+10 3e-2\n", toWml( "{ \"n\": [ 0, -1, 1.5, -0.25e3, 2E+10, 3e-2 ] }" ) );
+	const char *numbers[] = { "1-2-3", "...", "-", "01", "1.", ".5", "1e", "1e+", "--1", "+1", "1E5E5" };
+	for( auto number = std::begin( numbers ) ; number != std::end( numbers ) ; ++number ) {
+		ASSERT_THROW( toWml( std::string( "{ \"n\": " ) + *number + " }" ), LeanTextProcessing::TextException ) << *number;
+	}
+
+	// surrogate pairs
+	ASSERT_EQ( "u \xf0\x9f\x98\x80\n", toWml( "{ \"u\": \"\\uD83D\\uDE00\" }" ) );
+	ASSERT_THROW( toWml( "{ \"u\": \"\\uD800\\u0041\" }" ), LeanTextProcessing::TextException );
+	ASSERT_THROW( toWml( "{ \"u\": \"\\uD800\\uE000\" }" ), LeanTextProcessing::TextException );
+
+	// lone surrogates
+	ASSERT_THROW( toWml( "{ \"u\": \"\\uD800\" }" ), LeanTextProcessing::TextException );
+	ASSERT_THROW( toWml( "{ \"u\": \"\\uD800x\" }" ), LeanTextProcessing::TextException );
+	ASSERT_THROW( toWml( "{ \"u\": \"\\uD800\\n\" }" ), LeanTextProcessing::TextException );
+	ASSERT_THROW( toWml( "{ \"u\": \"\\uDC00\" }" ), LeanTextProcessing::TextException );
+	ASSERT_THROW( toWml( "{ \"u\": \"a\\uDFFFb\" }" ), LeanTextProcessing::TextException );
+}
+
+TEST( Json, roundTrip ) {
+	const std::string source =
+		"key:\n"
+		"\tsubKey valueA \"\\tvalueB\" 'value C'\n"
+		"\trawText \"some raw text\\nindentation gets stripped\"\n"
+		"\t'another sub key':\n"
+		"\t\temptyKey\n"
+		"flags:\n"
+		"\tread\n"
+		"\twrite\n";
+
+	// maps of keys without values stay maps (emit would write 'flags read write')
+	ASSERT_EQ( source, toWml( toJson( source ) ) );
+	ASSERT_EQ( toJson( source ), toJson( toWml( toJson( source ) ) ) );
+}
@@ -0,0 +1,117 @@
+/*
+Copyright 2013 Andreas Kirsch
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include "gtest.h"
+
+#include "wml_memory.h"
+
+using namespace wml;
+
+namespace {
+	Node makeTree() {
+		std::string text;
+		for( int i = 0 ; i < 100 ; ++i ) {
+			text += "entry:\n\tname 'a name that is too long for the small string buffer'\n\tvalues 1 2 3 4\n";
+		}
+		return parse( text, "a source name that is too long for the small string buffer" );
+	}
+}
+
+TEST( Memory, memoryUsage ) {
+	Node root = makeTree();
+	const MemoryUsage usage = memoryUsage( root );
+
+	// 100 entries with 2 keys and 5 values each
+	ASSERT_EQ( 800, usage.nodes );
+	ASSERT_EQ( 800 * sizeof( Node ), usage.nodeBytes );
+	ASSERT_GE( usage.contentBytes, 100 * 50 );
+	ASSERT_GE( usage.contextBytes, 800 * 50 );
+	ASSERT_EQ( 0, usage.packedBytes );
+	ASSERT_EQ( usage.nodeBytes + usage.childSlackBytes + usage.contentBytes + usage.contextBytes + usage.packedBytes + usage.indexBytes, usage.total() );
+
+	ASSERT_EQ( 0, memoryUsage( Node() ).total() );
+}
+
+TEST( Memory, compact ) {
+	Node root = makeTree();
+	const std::string emitted = emit( root );
+	const MemoryUsage before = memoryUsage( root );
+
+	CompactOptions options;
+	options.packValueLists = true;
+	compact( root, options );
+	const MemoryUsage after = memoryUsage( root );
+
+	ASSERT_EQ( emitted, emit( root ) );
+	ASSERT_EQ( 0, after.childSlackBytes );
+	ASSERT_EQ( before.nodes, after.nodes );
+	ASSERT_LT( after.nodeBytes, before.nodeBytes );
+	ASSERT_GT( after.packedBytes, 0 );
+	ASSERT_LT( after.total(), before.total() );
+
+	ASSERT_EQ( 4, root[0][ "values" ].size() );
+	ASSERT_EQ( 3, root[0][ "values" ].asArray< int >()[2] );
+	ASSERT_EQ( "a name that is too long for the small string buffer", root[0][ "name" ].as< std::string >() );
+}
+
+TEST( Memory, compactDefault ) {
+	Node root = makeTree();
+	const MemoryUsage before = memoryUsage( root );
+
+	// value lists stay unpacked and keep their positions
+	compact( root );
+	const MemoryUsage after = memoryUsage( root );
+	ASSERT_EQ( 0, after.packedBytes );
+	ASSERT_EQ( before.nodeBytes, after.nodeBytes );
+	ASSERT_EQ( 0, after.childSlackBytes );
+	ASSERT_EQ( 3, root[0][ "values" ][3].context.position.line );
+}
+
+TEST( Memory, unpackedValues ) {
+	Node root = makeTree();
+	CompactOptions options;
+	options.packValueLists = true;
+	compact( root, options );
+	const MemoryUsage packed = memoryUsage( root );
+
+	// children created by const access are counted with the packed lists
+	const Node &constRoot = root;
+	ASSERT_EQ( "4", constRoot[0][ "values" ][3].content );
+	const MemoryUsage unpacked = memoryUsage( root );
+	ASSERT_GE( unpacked.packedBytes, packed.packedBytes + 4 * sizeof( Node ) );
+	ASSERT_EQ( packed.nodeBytes, unpacked.nodeBytes );
+}
+
+TEST( Memory, compactDropContexts ) {
+	Node root = makeTree();
+
+	CompactOptions options;
+	options.dropContexts = true;
+	options.packValueLists = false;
+	compact( root, options );
+
+	const MemoryUsage usage = memoryUsage( root );
+	ASSERT_EQ( 0, usage.contextBytes );
+	ASSERT_EQ( 0, usage.packedBytes );
+	ASSERT_EQ( 0, usage.childSlackBytes );
+	ASSERT_EQ( "", root[0][ "name" ].context.name );
+}
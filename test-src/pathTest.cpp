@@ -0,0 +1,109 @@
+/*
+Copyright 2013 Andreas Kirsch
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include "gtest.h"
+
+#include "wml.h"
+
+using namespace wml;
+
+static const char *streamsText =
+	"streams:\n"
+	"\tstream:\n"
+	"\t\tflags:\n"
+	"\t\t\tread\n"
+	"\t\t\twrite:\n"
+	"\t\t\t\tusers andreas\n"
+	"\tstream:\n"
+	"\t\tflags:\n"
+	"\t\t\tread\n"
+	"\tstream:\n"
+	"\t\tflags:\n"
+	"\t\t\twrite:\n"
+	"\t\t\t\tusers root\n";
+
+TEST( Path, firstOccurrence ) {
+	const Node root = parse( streamsText );
+
+	const Node *flags = Path( "streams/stream/flags" ).first( root );
+	ASSERT_EQ( &root[ "streams" ][ 0 ][ "flags" ], flags );
+
+	ASSERT_EQ( nullptr, Path( "streams/streamX" ).first( root ) );
+	ASSERT_EQ( &root, Path( "" ).first( root ) );
+}
+
+TEST( Path, wildcards ) {
+	const Node root = parse( streamsText );
+
+	Path path( "streams/stream[*]/flags/write/users" );
+
+	std::vector< std::string > users;
+	for( auto &match : path.select( root ) ) {
+		users.push_back( match.value() );
+	}
+
+	ASSERT_EQ( 2, users.size() );
+	ASSERT_EQ( "andreas", users[0] );
+	ASSERT_EQ( "root", users[1] );
+
+	ASSERT_EQ( 3, Path( "streams/*" ).select( root ).count() );
+	ASSERT_EQ( 4, Path( "streams/*/flags/*" ).select( root ).count() );
+	ASSERT_EQ( "write", Path( "streams/*[2]/flags/*" ).first( root )->key() );
+	ASSERT_TRUE( Path( "streams/stream[3]" ).select( root ).empty() );
+}
+
+TEST( Path, repeatedKeyIndex ) {
+	Node root = parse( streamsText );
+
+	Node *stream = Path( "streams/stream[1]" ).first( root );
+	ASSERT_EQ( &root[ "streams" ][ 1 ], stream );
+
+	// non-const matches can be modified
+	Path( "streams/stream[2]/flags/write/users" ).first( root )->value() = "admin";
+	ASSERT_EQ( "admin", root[ "streams" ][ 2 ][ "flags" ][ "write" ][ "users" ].value() );
+}
+
+TEST( Path, quotedKeys ) {
+	const Node root = parse( "'key/with slash':\n\t'*' value\n" );
+
+	ASSERT_EQ( "value", Path( "'key/with slash'/'*'" ).first( root )->value() );
+}
+
+TEST( Path, deepPaths ) {
+	Node root;
+	Node *node = &root;
+	std::string text;
+	for( int i = 0 ; i < 12 ; ++i ) {
+		node = &node->push_back( "level" );
+		text += i ? "/level" : "level";
+	}
+
+	ASSERT_EQ( node, Path( text ).first( root ) );
+	ASSERT_EQ( 1, Path( text ).select( root ).count() );
+}
+
+TEST( Path, syntaxErrors ) {
+	ASSERT_THROW( Path( "a//b" ), LeanTextProcessing::TextException );
+	ASSERT_THROW( Path( "a[x]" ), LeanTextProcessing::TextException );
+	ASSERT_THROW( Path( "a[1" ), LeanTextProcessing::TextException );
+	ASSERT_THROW( Path( "'a" ), LeanTextProcessing::TextException );
+}
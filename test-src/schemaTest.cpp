@@ -0,0 +1,135 @@
+/*
+Copyright 2013 Andreas Kirsch
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include "gtest.h"
+
+#include "wml_schema.h"
+
+using namespace wml;
+
+static const char *schemaText =
+	"name\n"
+	"server:\n"
+	"\tcount 1..*\n"
+	"\tkeys:\n"
+	"\t\thost\n"
+	"\t\tport:\n"
+	"\t\t\ttype int\n"
+	"\t\tusers:\n"
+	"\t\t\tcount 0..1\n"
+	"\t\t\tvalues 1..*\n"
+	"\t\tmode:\n"
+	"\t\t\tcount 0..1\n"
+	"\t\t\tone-of read write\n"
+	"\t\textra:\n"
+	"\t\t\ttype any\n"
+	"\t\t\tcount *\n";
+
+static const char *validText =
+	"name test\n"
+	"server:\n"
+	"\thost localhost\n"
+	"\tport 80\n"
+	"\tusers a b\n"
+	"server:\n"
+	"\thost example.com\n"
+	"\tport 81\n"
+	"\tmode read\n"
+	"\textra:\n"
+	"\t\twhatever 1 2 3\n";
+
+// violations in both modes
+static void validateBoth( const Schema &schema, const std::string &text, std::vector< Violation > &fromTree, std::vector< Violation > &fromText ) {
+	fromTree = schema.validate( parse( text ) );
+	fromText = schema.validateText( text );
+
+	ASSERT_EQ( fromTree.size(), fromText.size() );
+	for( size_t i = 0 ; i < fromTree.size() ; ++i ) {
+		ASSERT_EQ( fromTree[i].message, fromText[i].message );
+		ASSERT_EQ( fromTree[i].context.position.line, fromText[i].context.position.line );
+	}
+}
+
+TEST( Schema, valid ) {
+	Schema schema( parse( schemaText ) );
+
+	std::vector< Violation > fromTree, fromText;
+	validateBoth( schema, validText, fromTree, fromText );
+	ASSERT_TRUE( fromTree.empty() );
+}
+
+TEST( Schema, violations ) {
+	Schema schema( parse( schemaText ) );
+
+	const char *text =
+		"name a b\n"
+		"server:\n"
+		"\thost localhost\n"
+		"\tport eighty\n"
+		"\tmode execute\n"
+		"\tmode read\n"
+		"\tcolor red\n"
+		"server:\n"
+		"\tusers\n";
+
+	std::vector< Violation > fromTree, fromText;
+	validateBoth( schema, text, fromTree, fromText );
+
+	// all violations are reported in document order (missing keys at the end of their map)
+	ASSERT_EQ( 8, fromTree.size() );
+	ASSERT_EQ( 1, fromTree[0].context.position.line );
+	ASSERT_NE( std::string::npos, fromTree[0].message.find( "values for 'name'" ) );
+	ASSERT_EQ( 4, fromTree[1].context.position.line );
+	ASSERT_NE( std::string::npos, fromTree[1].message.find( "not a valid int" ) );
+	ASSERT_NE( std::string::npos, fromTree[2].message.find( "not an allowed value" ) );
+	ASSERT_EQ( 6, fromTree[3].context.position.line );
+	ASSERT_NE( std::string::npos, fromTree[4].message.find( "unknown key 'color'" ) );
+	// missing users is fine (count 0..1)
+	ASSERT_NE( std::string::npos, fromTree[5].message.find( "values for 'users'" ) );
+	ASSERT_NE( std::string::npos, fromTree[6].message.find( "missing key 'host'" ) );
+	ASSERT_EQ( 8, fromTree[6].context.position.line );
+	ASSERT_NE( std::string::npos, fromTree[7].message.find( "missing key 'port'" ) );
+
+	// values where a map is expected
+	std::vector< Violation > violations = schema.validateText( "name a\nserver 1\n" );
+	ASSERT_EQ( 3, violations.size() );
+	ASSERT_NE( std::string::npos, violations[0].message.find( "expected map" ) );
+}
+
+TEST( Schema, packedValues ) {
+	Schema schema( parse( "values:\n\ttype int\n\tvalues 4\n" ) );
+
+	ParseOptions options;
+	options.packedValueLists = 2;
+
+	ASSERT_TRUE( schema.validate( parse( "values 1 2 3 4\n", "", options ) ).empty() );
+	ASSERT_EQ( 1, schema.validate( parse( "values 1 2 x 4\n", "", options ) ).size() );
+	ASSERT_EQ( 1, schema.validate( parse( "values 1 2 3\n", "", options ) ).size() );
+}
+
+TEST( Schema, invalidSchema ) {
+	ASSERT_THROW( Schema( parse( "key:\n\ttype number\n" ) ), LeanTextProcessing::TextException );
+	ASSERT_THROW( Schema( parse( "key:\n\tcount 2..1\n" ) ), LeanTextProcessing::TextException );
+	ASSERT_THROW( Schema( parse( "key:\n\tcolor red\n" ) ), LeanTextProcessing::TextException );
+	ASSERT_THROW( Schema( parse( "key\nkey\n" ) ), LeanTextProcessing::TextException );
+	ASSERT_THROW( Schema( parse( "key:\n\ttype int\n\tkeys:\n\t\tx\n" ) ), LeanTextProcessing::TextException );
+}
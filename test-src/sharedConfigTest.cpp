@@ -0,0 +1,110 @@
+/*
+Copyright 2013 Andreas Kirsch
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include "gtest.h"
+
+#include "wml_shared_config.h"
+
+#include <vector>
+
+using namespace wml;
+
+TEST( SharedConfig, snapshot ) {
+	SharedConfig config( parse( "version 1" ) );
+
+	SharedConfig::Snapshot snapshot = config.snapshot();
+	ASSERT_EQ( 1, snapshot->get<int>( "version" ) );
+
+	config.reload( "version 2" );
+
+	// old snapshots stay valid and unchanged
+	ASSERT_EQ( 1, snapshot->get<int>( "version" ) );
+	ASSERT_EQ( 2, config.snapshot()->get<int>( "version" ) );
+	ASSERT_EQ( 1, config.generation() );
+}
+
+TEST( SharedConfig, failedReloadKeepsTree ) {
+	SharedConfig config( parse( "version 1" ) );
+
+	ASSERT_THROW( config.reload( "version:\nbroken" ), LeanTextProcessing::TextException );
+	ASSERT_EQ( 1, config.snapshot()->get<int>( "version" ) );
+	ASSERT_EQ( 0, config.generation() );
+}
+
+TEST( SharedConfig, failedReloadFileKeepsTree ) {
+	SharedConfig config( parse( "version 1" ) );
+
+	ASSERT_FALSE( config.reloadFile( "does/not/exist.wml" ) );
+	ASSERT_EQ( 1, config.snapshot()->size() );
+	ASSERT_EQ( 1, config.read()->get<int>( "version" ) );
+	ASSERT_EQ( 0, config.generation() );
+}
+
+TEST( SharedConfig, readScope ) {
+	SharedConfig config( parse( "version 1" ) );
+
+	{
+		auto scope = config.read();
+		ASSERT_EQ( 1, scope->get<int>( "version" ) );
+		ASSERT_EQ( 1, (*scope).size() );
+	}
+
+	// the scope has been left, so publishing doesn't wait
+	config.reload( "version 2" );
+	ASSERT_EQ( 2, config.read()->get<int>( "version" ) );
+}
+
+TEST( SharedConfig, concurrentReaders ) {
+	SharedConfig config( parse( "a 0\nb 0" ) );
+
+	std::atomic< bool > done( false );
+	std::atomic< int > inconsistentReads( 0 );
+
+	std::vector< std::thread > readers;
+	for( int i = 0 ; i < 4 ; ++i ) {
+		readers.push_back( std::thread( [&] () {
+			while( !done ) {
+				SharedConfig::Snapshot snapshot = config.snapshot();
+				if( snapshot->get<int>( "a" ) != snapshot->get<int>( "b" ) ) {
+					++inconsistentReads;
+				}
+				auto scope = config.read();
+				if( scope->get<int>( "a" ) != scope->get<int>( "b" ) ) {
+					++inconsistentReads;
+				}
+			}
+		} ) );
+	}
+
+	for( int i = 1 ; i <= 200 ; ++i ) {
+		const std::string value = std::to_string( i );
+		config.reload( "a " + value + "\nb " + value );
+	}
+
+	done = true;
+	for( auto reader = readers.begin() ; reader != readers.end() ; ++reader ) {
+		reader->join();
+	}
+
+	ASSERT_EQ( 0, inconsistentReads );
+	ASSERT_EQ( 200, config.snapshot()->get<int>( "a" ) );
+}
@@ -0,0 +1,78 @@
+/*
+Copyright 2013 Andreas Kirsch
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include "gtest.h"
+
+#include "wml.h"
+
+using namespace wml;
+
+TEST( SharedNode, fromNode ) {
+	Node root = parse( "keyA valueA\nkeyB:\n\tkeyC 1 2 3\n\tkeyD 2\n" );
+	SharedNode shared( root );
+
+	ASSERT_EQ( 2, shared.size() );
+	ASSERT_EQ( "valueA", shared[ "keyA" ].value() );
+	ASSERT_EQ( 3, shared[ "keyB" ][ "keyC" ].size() );
+	ASSERT_EQ( 2, shared[ "keyB" ].get<int>( "keyD" ) );
+	ASSERT_EQ( 7, shared.getOr<int>( "keyX", 7 ) );
+	ASSERT_THROW( shared[ "keyX" ], LeanTextProcessing::TextException );
+
+	ASSERT_EQ( emit( root ), emit( shared.toNode() ) );
+}
+
+TEST( SharedNode, copiesShareData ) {
+	const SharedNode original( parse( "keyA valueA\nkeyB valueB" ) );
+	const SharedNode copy = original;
+
+	ASSERT_TRUE( copy.sharesDataWith( original ) );
+	ASSERT_EQ( &original[ 0 ].key(), &copy[ 0 ].key() );
+}
+
+TEST( SharedNode, writeClonesPathOnly ) {
+	SharedNode original( parse( "keyA:\n\tkeyB valueB\nkeyC:\n\tkeyD valueD" ) );
+	const SharedNode snapshot = original;
+
+	original[ "keyA" ][ "keyB" ].value() = "changed";
+
+	ASSERT_EQ( "changed", original[ "keyA" ][ "keyB" ].value() );
+	ASSERT_EQ( "valueB", snapshot[ "keyA" ][ "keyB" ].value() );
+
+	// the path to the changed node has been cloned
+	ASSERT_FALSE( original.sharesDataWith( snapshot ) );
+	ASSERT_FALSE( static_cast< const SharedNode & >( original )[ 0 ].sharesDataWith( snapshot[ 0 ] ) );
+	// everything else is still shared
+	ASSERT_TRUE( static_cast< const SharedNode & >( original )[ 1 ].sharesDataWith( snapshot[ 1 ] ) );
+}
+
+TEST( SharedNode, push_back_setValue ) {
+	SharedNode root;
+	root.push_back( "key" ).push_back( "value" );
+	const SharedNode snapshot = root;
+
+	root.push_back( "pie" ).setValue( 413 );
+
+	ASSERT_EQ( 2, root.size() );
+	ASSERT_EQ( 413, root.get<int>( "pie" ) );
+	ASSERT_EQ( 1, snapshot.size() );
+	ASSERT_EQ( "value", snapshot[ "key" ].value() );
+}
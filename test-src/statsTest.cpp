@@ -0,0 +1,94 @@
+/*
+Copyright 2013 Andreas Kirsch
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include "gtest.h"
+
+#include "wml.h"
+
+#include <cstdio>
+
+using namespace wml;
+
+// counts the allocations of the whole test program
+WML_DEFINE_COUNTING_OPERATOR_NEW
+
+namespace {
+	const char *document =
+		"title \"main\\twindow\"\n"
+		"size 10 20\n"
+		"window:\n"
+		"\tnested:\n"
+		"\t\tdeep value\n"
+		"\tdescription::\n"
+		"\t\tsome text\n"
+		"\t\tmore text\n";
+}
+
+TEST( Stats, parse ) {
+	Stats stats;
+	Node root = parse( document, "", ParseOptions(), &stats );
+
+	ASSERT_EQ( strlen( document ), stats.bytes );
+	// title, size, window, nested, deep, description + 5 values
+	ASSERT_EQ( 11, stats.nodes );
+	ASSERT_EQ( 4, stats.maxDepth );
+	ASSERT_EQ( 3, stats.maxFanOut );
+	ASSERT_EQ( 1, stats.escapedStrings );
+	ASSERT_EQ( 1, stats.textBlocks );
+	ASSERT_GE( stats.parseTime, 0.0 );
+	ASSERT_GT( stats.allocations, 0 );
+	ASSERT_GT( stats.allocatedBytes, 0 );
+
+	// counters add up
+	parse( document, "", ParseOptions(), &stats );
+	ASSERT_EQ( 2 * strlen( document ), stats.bytes );
+	ASSERT_EQ( 22, stats.nodes );
+}
+
+TEST( Stats, emit ) {
+	Node root = parse( document );
+
+	Stats stats;
+	const std::string text = emit( root, &stats );
+
+	ASSERT_EQ( emit( root ), text );
+	ASSERT_EQ( text.size(), stats.bytes );
+	ASSERT_EQ( 11, stats.nodes );
+	ASSERT_EQ( 4, stats.maxDepth );
+	// the emitter writes the text as an escaped string here
+	ASSERT_EQ( 2, stats.escapedStrings );
+	ASSERT_EQ( 0, stats.textBlocks );
+	ASSERT_GT( stats.allocations, 0 );
+}
+
+TEST( Stats, parseFile ) {
+	const std::string filename = "statsTest.wml";
+	emitFile( filename, parse( document ) );
+
+	Stats stats;
+	Node root = parseFile( filename, ParseOptions(), &stats );
+	std::remove( filename.c_str() );
+
+	ASSERT_EQ( 11, stats.nodes );
+	ASSERT_GE( stats.readTime, 0.0 );
+	ASSERT_GE( stats.parseTime, 0.0 );
+}
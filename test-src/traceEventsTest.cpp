@@ -0,0 +1,80 @@
+/*
+Copyright 2013 Andreas Kirsch
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include "gtest.h"
+
+// the parser and the emitter with tracing (the other test files are built without it)
+// the tree has a node type of its own, so the traced templates are instantiated only here
+#define WML_TRACE
+#include "wml.h"
+
+#include <algorithm>
+
+using namespace wml;
+
+namespace {
+	struct TracedTraits : DefaultNodeTraits {};
+	typedef BasicNode< TracedTraits > TracedNode;
+
+	std::vector< TraceEvent > eventsNamed( const std::vector< TraceEvent > &events, const char *name ) {
+		std::vector< TraceEvent > found;
+		std::copy_if( events.cbegin(), events.cend(), std::back_inserter( found ), [name] ( const TraceEvent &event ) {
+			return std::string( event.name ) == name;
+		} );
+		return found;
+	}
+}
+
+TEST( Trace, parseAndEmitEvents ) {
+	const std::string window =
+		"window:\n"
+		"\ttitle main\n"
+		"\tsize:\n"
+		"\t\twidth 640\n"
+		"\t\theight 480\n";
+	const std::string text = "version 2\n" + window + "end 1\n";
+
+	ChromeTrace trace;
+	const TracedNode root = parse< TracedNode >( text );
+
+	const std::vector< TraceEvent > parses = eventsNamed( trace.events, "parse" );
+	ASSERT_EQ( 1, parses.size() );
+	ASSERT_EQ( text.size(), parses[0].bytes );
+
+	// inner maps end first, each covers its lines (after the header's colon)
+	const std::vector< TraceEvent > maps = eventsNamed( trace.events, "parseMap" );
+	ASSERT_EQ( 2, maps.size() );
+	ASSERT_LT( maps[1].line, maps[0].line );
+	ASSERT_EQ( window.size() - window.find( ':' ) - 1, maps[1].bytes );
+	ASSERT_EQ( window.size() - window.find( "size:" ) - 5, maps[0].bytes );
+	ASSERT_LE( maps[1].start, maps[0].start );
+	ASSERT_LE( parses[0].start, maps[1].start );
+
+	trace.events.clear();
+	const std::string emitted = detail::emit( root );
+	ASSERT_EQ( text, emitted );
+
+	const std::vector< TraceEvent > emits = eventsNamed( trace.events, "emit" );
+	ASSERT_EQ( 1, emits.size() );
+	ASSERT_EQ( emitted.size(), emits[0].bytes );
+	ASSERT_EQ( 2, eventsNamed( trace.events, "emitMap" ).size() );
+}
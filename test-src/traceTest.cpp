@@ -0,0 +1,60 @@
+/*
+Copyright 2013 Andreas Kirsch
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include "gtest.h"
+
+// only the trace header: the parser and emitter in the other test files are built without tracing
+#define WML_TRACE
+#include "wml_trace.h"
+
+#include <sstream>
+
+using namespace wml;
+
+TEST( Trace, chromeTrace ) {
+	std::ostringstream json;
+	{
+		ChromeTrace trace;
+		{
+			WML_TRACE_SCOPE( "outer", 0 );
+			WML_TRACE_SCOPE_IF( true, "inner", 42 );
+			WML_TRACE_SCOPE_IF( false, "skipped", 1 );
+		}
+		ASSERT_EQ( 2, trace.events.size() );
+		// inner scopes end first
+		ASSERT_STREQ( "inner", trace.events[0].name );
+		ASSERT_EQ( 42, trace.events[0].line );
+		ASSERT_STREQ( "outer", trace.events[1].name );
+		ASSERT_LE( trace.events[1].start, trace.events[0].start );
+
+		trace.write( json );
+	}
+
+	const std::string text = json.str();
+	ASSERT_EQ( 0, text.find( "{\"traceEvents\":[" ) );
+	ASSERT_NE( std::string::npos, text.find( "\"name\":\"inner\",\"cat\":\"wml\",\"ph\":\"X\"" ) );
+	ASSERT_NE( std::string::npos, text.find( "\"args\":{\"line\":42}" ) );
+
+	// no hook after the trace is gone
+	WML_TRACE_SCOPE( "unobserved", 0 );
+	ASSERT_FALSE( detail::traceHook() );
+}
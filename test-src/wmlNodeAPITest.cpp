@@ -24,6 +24,9 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include "wml.h"
 
+#include <algorithm>
+#include <thread>
+
 using namespace wml;
 
 TEST( API, empty_size_index_key_value ) {
@@ -160,4 +163,531 @@ TEST( API, push_back ) {
 	ASSERT_EQ( 2, root.size() );
 	ASSERT_EQ( "value", root[ "key" ].value() );
 	ASSERT_EQ( 413, root.get<int>( "pie" ) );
-}
\ No newline at end of file
+}
+TEST( API, keyIndex ) {
+	Node root;
+	for( int i = 0 ; i < 100 ; i++ ) {
+		root.push_back( "key" + std::to_string( i ) ).push_back( i );
+		root.push_back( "repeated" ).push_back( i );
+	}
+
+	for( int i = 0 ; i < 100 ; i++ ) {
+		ASSERT_EQ( i, root.get<int>( "key" + std::to_string( i ) ) );
+	}
+	ASSERT_EQ( root.end(), root.find( "keyX" ) );
+	ASSERT_EQ( -1, root.getOr<int>( "keyX", -1 ) );
+
+	auto repeated = root.getNodes( "repeated" );
+	ASSERT_EQ( 100, repeated.size() );
+	for( int i = 0 ; i < 100 ; i++ ) {
+		ASSERT_EQ( i, repeated[i]->as<int>() );
+	}
+
+	// the index follows changes
+	root.push_back( "keyX" ).push_back( 1 );
+	ASSERT_EQ( 1, root.get<int>( "keyX" ) );
+
+	root.nodes.erase( root.nodes.begin() );
+	ASSERT_EQ( root.end(), root.find( "key0" ) );
+
+	root[ "key1" ].key() = "keyY";
+	root.invalidateKeyIndex();
+	ASSERT_EQ( 1, root.get<int>( "keyY" ) );
+	ASSERT_EQ( root.end(), root.find( "key1" ) );
+}
+
+TEST( API, keyIndex_directChanges ) {
+	Node root;
+	for( int i = 0 ; i < 100 ; i++ ) {
+		root.push_back( "key" + std::to_string( i ) ).push_back( i );
+	}
+	const Node &constRoot = root;
+	ASSERT_EQ( 5, constRoot.get<int>( "key5" ) );
+
+	// same storage and size as before
+	root.nodes.erase( root.nodes.begin() );
+	root.nodes.push_back( Node( "newKey" ) );
+	ASSERT_TRUE( root.findPtr( "key5" ) != nullptr );
+	ASSERT_TRUE( root.findPtr( "newKey" ) != nullptr );
+	ASSERT_EQ( nullptr, root.findPtr( "key0" ) );
+	ASSERT_EQ( 5, constRoot.get<int>( "key5" ) );
+	ASSERT_TRUE( constRoot.findPtr( "newKey" ) != nullptr );
+
+	std::sort( root.nodes.begin(), root.nodes.end(), [] ( const Node &a, const Node &b ) { return a.key() > b.key(); } );
+	ASSERT_EQ( 42, root.get<int>( "key42" ) );
+	ASSERT_EQ( &root.nodes.back(), root.findPtr( "key1" ) );
+	root.invalidateKeyIndex();
+	ASSERT_EQ( 42, constRoot.get<int>( "key42" ) );
+	ASSERT_EQ( &root.nodes.back(), constRoot.findPtr( "key1" ) );
+
+	// renaming through the views
+	for( auto &key : root.keys() ) {
+		if( key == "key7" ) {
+			key = "renamed";
+		}
+	}
+	ASSERT_EQ( 7, constRoot.get<int>( "renamed" ) );
+	ASSERT_EQ( nullptr, constRoot.findPtr( "key7" ) );
+
+	// duplicates found through the index after direct changes
+	root.nodes[ 0 ].key() = "renamed";
+	root.nodes[ 1 ].key() = "renamed";
+	root.invalidateKeyIndex();
+	ASSERT_EQ( 3, std::distance( constRoot.children( "renamed" ).begin(), constRoot.children( "renamed" ).end() ) );
+	root.nodes[ 1 ].key() = "other";
+	ASSERT_EQ( 2, root.getNodes( "renamed" ).size() );
+}
+
+TEST( API, keyIndex_nonConstAccess ) {
+	Node root;
+	for( int i = 0 ; i < 100 ; i++ ) {
+		root.push_back( "k" + std::to_string( i ) ).push_back( i );
+	}
+	const Node &constRoot = root;
+
+	// non-const lookups use the index and keep it, adding children extends it
+	ASSERT_EQ( 5, root[ "k5" ].as<int>() );
+	const detail::KeyIndex *index = root.keyIndex.index.load();
+	ASSERT_TRUE( index != nullptr );
+	ASSERT_EQ( 7, constRoot.get<int>( "k7" ) );
+	ASSERT_TRUE( root.findPtr( "k9" ) != nullptr );
+	root.push_back( "k100" ).push_back( 100 );
+	ASSERT_EQ( index, root.keyIndex.index.load() );
+	ASSERT_EQ( 100, root.get<int>( "k100" ) );
+
+	// renames through references taken earlier
+	Node &child5 = root[ 5 ];
+	ASSERT_TRUE( constRoot.findPtr( "k5" ) != nullptr );
+	child5.key() = "renamed";
+	ASSERT_EQ( &child5, constRoot.findPtr( "renamed" ) );
+	ASSERT_EQ( nullptr, constRoot.findPtr( "k5" ) );
+
+	// renaming to an existing key makes the earlier child the first match
+	ASSERT_EQ( 7, constRoot.find( "k7" ) - constRoot.begin() );
+	root[ 3 ].key() = "k7";
+	ASSERT_EQ( 3, constRoot.find( "k7" ) - constRoot.begin() );
+	ASSERT_EQ( 3, root.find( "k7" ) - root.begin() );
+	ASSERT_EQ( 2, root.getNodes( "k7" ).size() );
+	ASSERT_EQ( nullptr, root.findPtr( "k3" ) );
+
+	// replacing the last child directly
+	root.nodes.pop_back();
+	root.nodes.push_back( Node( "last" ) );
+	ASSERT_TRUE( constRoot.findPtr( "last" ) != nullptr );
+	ASSERT_EQ( nullptr, constRoot.findPtr( "k100" ) );
+}
+
+TEST( API, keyIndex_concurrentLookups ) {
+	Node root;
+	for( int i = 0 ; i < 1000 ; i++ ) {
+		root.push_back( "key" + std::to_string( i ) ).push_back( i );
+	}
+
+	const Node &constRoot = root;
+	std::atomic< int > failures( 0 );
+
+	std::vector< std::thread > threads;
+	for( int t = 0 ; t < 4 ; t++ ) {
+		threads.push_back( std::thread( [&] () {
+			for( int i = 0 ; i < 1000 ; i++ ) {
+				if( constRoot.get<int>( "key" + std::to_string( i ) ) != i ) {
+					++failures;
+				}
+			}
+		} ) );
+	}
+	for( auto thread = threads.begin() ; thread != threads.end() ; ++thread ) {
+		thread->join();
+	}
+
+	ASSERT_EQ( 0, failures );
+}
+
+TEST( API, string_view_keys ) {
+	const Node root = parse( "keyA 1\nkeyB 2" );
+
+	const std::string keyA = "keyA";
+	const std::string_view keyB = "keyB";
+
+	ASSERT_EQ( 1, root[ keyA ].as<int>() );
+	ASSERT_EQ( 2, root[ keyB ].as<int>() );
+	ASSERT_EQ( 2, root.get<int>( keyB.substr( 0, 4 ) ) );
+	ASSERT_EQ( root.cbegin(), root.find( keyA ) );
+}
+
+TEST( API, findPtr_tryGet ) {
+	Node root = parse( "key 0" );
+
+	ASSERT_EQ( &root[ 0 ], root.findPtr( "key" ) );
+	ASSERT_EQ( nullptr, root.findPtr( "keyX" ) );
+
+	ASSERT_EQ( 0, root.tryGet<int>( "key" ).value() );
+	ASSERT_FALSE( root.tryGet<int>( "keyX" ).has_value() );
+}
+
+TEST( API, children ) {
+	Node root = parse( "value 0\nvalue 1\notherKey\nvalue 2" );
+
+	ASSERT_TRUE( root.children( "key" ).empty() );
+
+	int i = 0;
+	for( Node &value : root.children( "value" ) ) {
+		ASSERT_EQ( i++, value.as<int>() );
+	}
+	ASSERT_EQ( 3, i );
+
+	const Node &constRoot = root;
+	ASSERT_EQ( 3, std::distance( constRoot.children( "value" ).begin(), constRoot.children( "value" ).end() ) );
+}
+
+TEST( API, keys_values ) {
+	Node root = parse( "keyA valueA valueB\nkeyB valueC" );
+
+	std::vector< std::string > keys( root.keys().begin(), root.keys().end() );
+	ASSERT_EQ( 2, keys.size() );
+	ASSERT_EQ( "keyA", keys[0] );
+	ASSERT_EQ( "keyB", keys[1] );
+
+	const Node &constRoot = root;
+	std::string joined;
+	for( std::string_view value : constRoot[ "keyA" ].values() ) {
+		joined += value;
+	}
+	ASSERT_EQ( "valueAvalueB", joined );
+
+	// non-const values can be changed
+	for( std::string &value : root[ "keyA" ].values() ) {
+		value += "!";
+	}
+	ASSERT_EQ( "valueA!", root[ "keyA" ][ 0 ].content );
+}
+
+#ifdef __cpp_lib_ranges
+TEST( API, ranges ) {
+	const Node root = parse( "value 0\nvalue 1\notherKey\nvalue 2\nvalues 3 4 5" );
+
+	auto odd = root.children( "value" )
+		| std::views::transform( [] ( const Node &node ) { return node.as<int>(); } )
+		| std::views::filter( [] ( int value ) { return value % 2 == 1; } );
+	ASSERT_EQ( 1, std::ranges::distance( odd ) );
+
+	ASSERT_EQ( 2, std::ranges::distance( root[ "values" ].values() | std::views::drop( 1 ) ) );
+}
+#endif
+
+TEST( API, conversion ) {
+	Node root = parse( "int -42\nplus +7\nfloat 0.1\nbool true\nnumeric 1\nbad 12abc\nchar x" );
+
+	ASSERT_EQ( -42, root.get<int>( "int" ) );
+	ASSERT_EQ( 7, root.get<long long>( "plus" ) );
+	ASSERT_EQ( 0.1f, root.get<float>( "float" ) );
+	ASSERT_EQ( 0.1, root.get<double>( "float" ) );
+	ASSERT_TRUE( root.get<bool>( "bool" ) );
+	ASSERT_TRUE( root.get<bool>( "numeric" ) );
+	ASSERT_EQ( 'x', root.get<char>( "char" ) );
+
+	ASSERT_THROW( root.get<int>( "bad" ), LeanTextProcessing::TextException );
+	ASSERT_THROW( root.get<unsigned>( "int" ), LeanTextProcessing::TextException );
+	ASSERT_THROW( root.get<bool>( "float" ), LeanTextProcessing::TextException );
+
+	// errors point at the value
+	try {
+		root.get<int>( "bad" );
+	}
+	catch( const LeanTextProcessing::TextException &exception ) {
+		ASSERT_EQ( 6, exception.context.position.line );
+	}
+
+	// floats are formatted with the shortest exact representation
+	root[ "float" ].setValue( 0.1f );
+	ASSERT_EQ( "0.1", root[ "float" ].value() );
+	root[ "bool" ].setValue( false );
+	ASSERT_EQ( "0", root[ "bool" ].value() );
+	ASSERT_FALSE( root.get<bool>( "bool" ) );
+}
+
+struct Point {
+	int x, y;
+};
+
+namespace wml {
+	template<>
+	struct Converter< Point > {
+		static bool parse( std::string_view text, Point &value ) {
+			const size_t comma = text.find( ',' );
+			return comma != std::string_view::npos &&
+				Converter< int >::parse( text.substr( 0, comma ), value.x ) &&
+				Converter< int >::parse( text.substr( comma + 1 ), value.y );
+		}
+
+		static void format( const Point &value, std::string &text ) {
+			text = std::to_string( value.x ) + "," + std::to_string( value.y );
+		}
+	};
+}
+
+TEST( API, customConversion ) {
+	Node root;
+
+	Point point = { 1, 2 };
+	root.push_back( "point" ).push_back( point );
+	ASSERT_EQ( "1,2", root[ "point" ].value() );
+
+	Point parsed = root.get<Point>( "point" );
+	ASSERT_EQ( 1, parsed.x );
+	ASSERT_EQ( 2, parsed.y );
+}
+
+TEST( API, asArray_readInto ) {
+	Node root = parse( "values 1 2 3\nfloats 0.5 -1e3\nmixed 1 x" );
+
+	std::vector< int > values = root[ "values" ].asArray<int>();
+	ASSERT_EQ( 3, values.size() );
+	ASSERT_EQ( 3, values[2] );
+
+	double floats[2];
+	root[ "floats" ].readInto( floats, 2 );
+	ASSERT_EQ( 0.5, floats[0] );
+	ASSERT_EQ( -1000.0, floats[1] );
+
+	ASSERT_THROW( root[ "floats" ].readInto( floats, 1 ), LeanTextProcessing::TextException );
+	ASSERT_THROW( root[ "mixed" ].asArray<int>(), LeanTextProcessing::TextException );
+}
+
+TEST( API, packedNumberLists ) {
+	ParseOptions options;
+	options.packedNumberLists = 4;
+	const std::string text = "short 1 2 3\nlong 1 -2 +3 4.5e1\t6\nnames a b c d e\nmap:\n\tlong 7 8 9 10\n";
+	Node root = parse( text, "", options );
+
+	ASSERT_FALSE( root[ "short" ].packed );
+	ASSERT_TRUE( root[ "names" ].packed == nullptr );
+
+	const Node &packed = root[ "long" ];
+	ASSERT_TRUE( packed.packed != nullptr );
+	ASSERT_EQ( 5, packed.size() );
+	ASSERT_EQ( "4.5e1", packed.valueAt( 3 ) );
+	ASSERT_EQ( "-2", packed[1].key() );
+	ASSERT_EQ( 7, root[ "map" ][ "long" ].asArray<int>()[0] );
+	ASSERT_EQ( 4, root[ "map" ].context.position.line );
+	ASSERT_EQ( 2, packed.packed->context.position.line );
+
+	// lists that start with numbers but contain other values aren't number lists
+	ASSERT_FALSE( parse( "mixed 1 2 3 4 x\n", "", options )[ "mixed" ].packed );
+	// neither are values that only consist of number characters
+	for( const char *list : { "e 1 2 3", "1 - 2 3", "1 2 +. 3", "1 2 3 E-", "1 2 3 1e", "1 2 3 1.2.3", "1 2 3 --1" } ) {
+		const Node bad = parse( std::string( "bad " ) + list, "", options );
+		ASSERT_FALSE( bad[ "bad" ].packed ) << list;
+		ASSERT_EQ( 4, bad[ "bad" ].size() );
+	}
+	ASSERT_TRUE( parse( "good +.5 2. 1e-3 -7E+2", "", options )[ "good" ].packed != nullptr );
+
+	// single values are never packed
+	options.packedNumberLists = 1;
+	ASSERT_FALSE( parse( "single 1\n", "", options )[ "single" ].packed );
+	ASSERT_TRUE( parse( "pair 1 2\n", "", options )[ "pair" ].packed != nullptr );
+	options.packedNumberLists = 4;
+
+	int values[4];
+	ASSERT_THROW( packed.readInto( values, 4 ), LeanTextProcessing::TextException );
+	ASSERT_THROW( packed.asArray<int>(), LeanTextProcessing::TextException );
+
+	std::vector< double > doubles = packed.asArray<double>();
+	ASSERT_EQ( 45.0, doubles[3] );
+
+	// the packed values are emitted like normal values
+	ASSERT_EQ( emit( parse( text ) ), emit( root ) );
+
+	// modifying the list unpacks it
+	root[ "long" ].push_back( "7" );
+	ASSERT_FALSE( root[ "long" ].packed );
+	ASSERT_EQ( 6, root[ "long" ].size() );
+	ASSERT_EQ( "4.5e1", root[ "long" ][3].key() );
+}
+
+TEST( API, packedValueLists ) {
+	ParseOptions options;
+	options.packedValueLists = 3;
+	const std::string text = "pair a b\nlist a 'b c' \"d\\te\" f\nsingle x\n";
+	Node root = parse( text, "", options );
+
+	ASSERT_FALSE( root[ "pair" ].packed );
+	ASSERT_EQ( "x", root[ "single" ].value() );
+
+	const Node &list = root[ "list" ];
+	ASSERT_TRUE( list.packed != nullptr );
+	ASSERT_EQ( 4, list.size() );
+	ASSERT_FALSE( list.empty() );
+	ASSERT_EQ( "b c", list.valueAt( 1 ) );
+	ASSERT_EQ( "d\te", list[2].key() );
+	ASSERT_THROW( list.value(), LeanTextProcessing::TextException );
+
+	std::vector< std::string > values;
+	for( std::string_view value : list.values() ) {
+		values.push_back( std::string( value ) );
+	}
+	ASSERT_EQ( 4, values.size() );
+	ASSERT_EQ( "f", values[3] );
+
+	int count = 0;
+	for( const Node &value : list ) {
+		ASSERT_TRUE( value.empty() );
+		++count;
+	}
+	ASSERT_EQ( 4, count );
+
+	ASSERT_EQ( emit( parse( text ) ), emit( root ) );
+}
+
+TEST( API, moveSemantics ) {
+	static_assert( std::is_nothrow_move_constructible< Node >::value, "vectors of nodes have to move them" );
+	static_assert( std::is_nothrow_move_assignable< Node >::value, "" );
+	static_assert( std::is_nothrow_move_constructible< LeanTextProcessing::TextContext >::value, "" );
+
+	Node root;
+	root.reserve( 2 );
+	Node &entry = root.emplace_back( "entry" );
+	entry.emplace_back( "value" );
+	root.emplace_back( std::string( "text" ), LeanTextProcessing::TextContext() ).push_back( "content" );
+
+	ASSERT_EQ( 2, root.size() );
+	ASSERT_EQ( "value", root[ "entry" ].value() );
+	ASSERT_EQ( "content", root[ "text" ].value() );
+
+	// moving keeps the storage of the children
+	const Node *children = root.nodes.data();
+	Node moved;
+	moved = std::move( root );
+	ASSERT_EQ( children, moved.nodes.data() );
+	ASSERT_EQ( 2, moved.size() );
+
+	Node pushed;
+	pushed.push_back( std::move( moved ) );
+	ASSERT_EQ( children, pushed[0].nodes.data() );
+}
+
+TEST( API, parsedChildVectorsAreExact ) {
+	Node root = parse( "a:\n\tb 1 2 3\n\tc\n\td:\n\t\te f\nb 4\n" );
+
+	ASSERT_EQ( root.size(), root.nodes.capacity() );
+	ASSERT_EQ( 3, root[ "a" ].nodes.capacity() );
+	ASSERT_EQ( 3, root[ "a" ][ "b" ].nodes.capacity() );
+	ASSERT_EQ( "f", root[ "a" ][ "d" ][ "e" ].value() );
+	ASSERT_EQ( 4, root.get< int >( "b" ) );
+}
+
+TEST( BasicNode, compactNode ) {
+	const std::string text = "a:\n\tb 1 2 3\n\tc 'x y'\nd \"e\\tf\"\n";
+	CompactNode root = parse< CompactNode >( text );
+
+	static_assert( sizeof( CompactNode ) < sizeof( Node ), "compact nodes don't store a context" );
+
+	ASSERT_EQ( 2, root.size() );
+	ASSERT_EQ( "x y", root[ "a" ][ "c" ].value() );
+	ASSERT_EQ( std::vector< int >( { 1, 2, 3 } ), root[ "a" ][ "b" ].asArray< int >() );
+	ASSERT_EQ( "e\tf", root.get< std::string >( "d" ) );
+	ASSERT_EQ( emit( parse( text ) ), emit( root ) );
+
+	// errors don't show the source
+	try {
+		root[ "a" ].get< int >( "c" );
+		FAIL();
+	}
+	catch( const LeanTextProcessing::TextException &exception ) {
+		ASSERT_TRUE( exception.context.surroundingText.empty() );
+	}
+
+	ParseOptions options;
+	options.packedValueLists = 2;
+	CompactNode packed = parse< CompactNode >( "list 1 2 3\n", "", options );
+	ASSERT_TRUE( packed[ "list" ].packed != nullptr );
+	ASSERT_EQ( 3, packed[ "list" ].asArray< int >()[2] );
+	ASSERT_EQ( "list 1 2 3\n", emit( packed ) );
+}
+
+namespace {
+	size_t numAllocatedNodes = 0;
+
+	template< typename T >
+	struct CountingAllocator : std::allocator< T > {
+		template< typename U >
+		struct rebind {
+			typedef CountingAllocator< U > other;
+		};
+
+		T *allocate( size_t count ) {
+			numAllocatedNodes += count;
+			return std::allocator< T >::allocate( count );
+		}
+
+		CountingAllocator() {}
+		template< typename U >
+		CountingAllocator( const CountingAllocator< U > & ) {}
+	};
+
+	struct CountingTraits : DefaultNodeTraits {
+		template< typename NodeT >
+		using Container = std::vector< NodeT, CountingAllocator< NodeT > >;
+	};
+}
+
+TEST( BasicNode, customContainer ) {
+	typedef BasicNode< CountingTraits > CountingNode;
+
+	numAllocatedNodes = 0;
+	CountingNode root = parse< CountingNode >( "a:\n\tb 1\n\tc 2\nd 3\n" );
+	ASSERT_LT( 0, numAllocatedNodes );
+	ASSERT_EQ( 2, root.nodes.capacity() );
+
+	root.push_back( "e" ).setValue( 4 );
+	ASSERT_EQ( 2, root[ "a" ].get< int >( "c" ) );
+	ASSERT_EQ( 4, root.get< int >( "e" ) );
+	ASSERT_EQ( "a:\n\tb 1\n\tc 2\nd 3\ne 4\n", emit( root ) );
+}
+
+namespace {
+	// copies its elements when it is moved (std::vector keeps its storage)
+	template< typename T >
+	struct CopyingVector : std::vector< T > {
+		CopyingVector() {}
+		template< typename Iterator >
+		CopyingVector( Iterator begin, Iterator end ) : std::vector< T >( begin, end ) {}
+		CopyingVector( const CopyingVector & ) = default;
+		CopyingVector( CopyingVector &&other ) : std::vector< T >( other ) {}
+		CopyingVector & operator = ( const CopyingVector & ) = default;
+		CopyingVector & operator = ( CopyingVector && ) = default;
+	};
+
+	struct CopyingTraits : DefaultNodeTraits {
+		template< typename NodeT >
+		using Container = CopyingVector< NodeT >;
+	};
+}
+
+TEST( BasicNode, copyingContainer ) {
+	typedef BasicNode< CopyingTraits > CopyingNode;
+
+	// the parser keeps one container per depth, which are copied when a deeper entry is opened
+	const std::string source = "a:\n\tb:\n\t\tc:\n\t\t\td:\n\t\t\t\te 1\n\t\t\tf 2\n\tg 3\nh 4\n";
+	CopyingNode root = parse< CopyingNode >( source );
+	ASSERT_EQ( 1, root[ "a" ][ "b" ][ "c" ][ "d" ].get< int >( "e" ) );
+	ASSERT_EQ( 2, root[ "a" ][ "b" ][ "c" ].get< int >( "f" ) );
+	ASSERT_EQ( 3, root[ "a" ].get< int >( "g" ) );
+	ASSERT_EQ( source, emit( root ) );
+}
+
+#ifdef __cpp_lib_memory_resource
+TEST( BasicNode, pmrNode ) {
+	char buffer[ 4096 ];
+	std::pmr::monotonic_buffer_resource resource( buffer, sizeof( buffer ), std::pmr::null_memory_resource() );
+
+	std::pmr::memory_resource *previous = std::pmr::set_default_resource( &resource );
+	PmrNode root = parse< PmrNode >( "key 'a value that does not fit into a small string'\nlist:\n\tx 1\n" );
+	std::pmr::set_default_resource( previous );
+
+	ASSERT_EQ( &resource, root[ "key" ].value().get_allocator().resource() );
+	ASSERT_EQ( "a value that does not fit into a small string", root.get< std::string >( "key" ) );
+	ASSERT_EQ( 1, root[ "list" ].get< int >( "x" ) );
+	ASSERT_EQ( "key 'a value that does not fit into a small string'\nlist:\n\tx 1\n", emit( root ) );
+}
+#endif
@@ -24,6 +24,8 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include "wml.h"
 
+#include <sstream>
+
 using namespace wml;
 
 TEST( Parser, empty )  {
@@ -338,4 +340,260 @@ TEST( Emitter, weirdValues ) {
 TEST( Emitter, emptyContent ) {
 	emitTest( "key ''");
 	emitTest( "'' ''");
-}
\ No newline at end of file
+}
+TEST( Emitter, streaming ) {
+	Node root = parse( 
+		"key:\n"
+		"\ta\n"
+		"\tb 1 2 3\n"
+		"\ttext::\n"
+		"\t\tsome data\n"
+		"\t\tmore data\n"
+		"\t\tmore data\n"
+		"\tc \"x\\ty\" 'z w'\n"
+		);
+	const std::string emitted = emit( root );
+
+	// 0 is treated as 1
+	const size_t bufferSizes[] = { 0, 1, 7, 4096 };
+	for( size_t i = 0 ; i < 4 ; ++i ) {
+		std::string streamed;
+		size_t largestChunk = 0;
+		emit( root, [&] ( const char *data, size_t size ) {
+			streamed.append( data, size );
+			largestChunk = std::max( largestChunk, size );
+		}, bufferSizes[i] );
+
+		ASSERT_EQ( emitted, streamed );
+		// only values that are bigger than the buffer are passed on directly
+		if( bufferSizes[i] > emitted.size() ) {
+			ASSERT_EQ( emitted.size(), largestChunk );
+		}
+	}
+
+	std::ostringstream stream;
+	emit( root, stream );
+	ASSERT_EQ( emitted, stream.str() );
+}
+
+TEST( Emitter, emitInto ) {
+	Node root = parse( 
+		"key:\n"
+		"\ta\n"
+		"\tb 1 2 3\n"
+		"\tc \"x\\ty\" 'z w'\n"
+		);
+	const std::string emitted = emit( root );
+
+	ASSERT_EQ( emitted.size(), emittedSize( root ) );
+	ASSERT_EQ( 0, emittedSize( Node() ) );
+
+	std::vector< char > buffer( emitted.size() );
+	ASSERT_EQ( emitted.size(), emitInto( root, buffer.data(), buffer.size() ) );
+	ASSERT_EQ( emitted, std::string( buffer.begin(), buffer.end() ) );
+
+	// too small: returns the required size and doesn't write past the end
+	buffer.assign( emitted.size() + 1, '#' );
+	ASSERT_EQ( emitted.size(), emitInto( root, buffer.data(), 5 ) );
+	ASSERT_EQ( emitted.substr( 0, 5 ), std::string( buffer.begin(), buffer.begin() + 5 ) );
+	ASSERT_EQ( '#', buffer[5] );
+}
+
+TEST( Emitter, emitParallel ) {
+	Node root;
+	for( int i = 0 ; i < 100 ; ++i ) {
+		Node &entry = root.push_back( "entry" );
+		entry.push_back( "values" ).push_back( i ).push_back( "some text" );
+		Node &nested = entry.push_back( "nested" );
+		for( int j = 0 ; j < i % 7 ; ++j ) {
+			nested.push_back( "key" ).push_back( "text::\nwith\nlines" );
+		}
+	}
+	Node wrapped;
+	wrapped.push_back( "root" ).push_back( root );
+
+	for( unsigned numThreads = 1 ; numThreads <= 8 ; numThreads *= 2 ) {
+		ASSERT_EQ( emit( root ), emitParallel( root, numThreads ) );
+		ASSERT_EQ( emit( wrapped ), emitParallel( wrapped, numThreads ) );
+	}
+	ASSERT_EQ( "", emitParallel( Node(), 4 ) );
+}
+
+TEST( Emitter, emitParallel_narrowChains ) {
+	Node root;
+	Node *bottom = &root;
+	for( int depth = 0 ; depth < 20 ; ++depth ) {
+		bottom = &bottom->push_back( "level" );
+	}
+	for( int i = 0 ; i < 100 ; ++i ) {
+		bottom->push_back( "entry" ).push_back( "key" ).push_back( i );
+	}
+
+	// the chain of maps is split down to the wide level
+	detail::ParallelEmission emission( root, 4 );
+	ASSERT_LT( 2, emission.parts.size() );
+	ASSERT_EQ( emit( root ), emitParallel( root, 4 ) );
+}
+
+TEST( Emitter, emitParallel_unevenChildren ) {
+	// a few big subtrees at the front and many small entries
+	Node root;
+	for( int i = 0 ; i < 8 ; ++i ) {
+		Node &big = root.push_back( "big" );
+		for( int j = 0 ; j < 1000 ; ++j ) {
+			big.push_back( "key" ).push_back( j );
+		}
+	}
+	for( int i = 0 ; i < 1000 ; ++i ) {
+		root.push_back( "small" ).push_back( i );
+	}
+	const std::string emitted = emit( root );
+
+	// the parts are split by size, not by the number of children
+	detail::ParallelEmission emission( root, 2 );
+	size_t largestPart = 0;
+	for( auto part = emission.parts.cbegin() ; part != emission.parts.cend() ; ++part ) {
+		largestPart = std::max( largestPart, part->text.size() );
+	}
+	ASSERT_LT( largestPart, emitted.size() / 4 );
+	ASSERT_EQ( emitted, emitParallel( root, 2 ) );
+}
+
+TEST( Emitter, emitPreserving ) {
+	const std::string source =
+		"version 2\n"
+		"name\t\t'my app'\n"
+		"size\t\t10 20\n"
+		"\n"
+		"window:\n"
+		"\ttitle   \"main window\"\n"
+		"\n"
+		"\tvisible true\n"
+		"notes::\n"
+		"\tsome text\n"
+		"end 1";
+
+	ParseOptions options;
+	options.trackSourceSpans = true;
+	Node root = parse( source, "", options );
+	ASSERT_EQ( source, emitPreserving( root, source ) );
+
+	// only the modified entry is re-emitted
+	root[ "window" ][ "visible" ].setValue( "false" );
+	ASSERT_EQ(
+		"version 2\n"
+		"name\t\t'my app'\n"
+		"size\t\t10 20\n"
+		"\n"
+		"window:\n"
+		"\ttitle   \"main window\"\n"
+		"\n"
+		"\tvisible false\n"
+		"notes::\n"
+		"\tsome text\n"
+		"end 1",
+		emitPreserving( root, source )
+	);
+
+	// new and removed entries
+	root[ "window" ].push_back( "width" ).push_back( 640 );
+	root.nodes.erase( root.nodes.begin() + 2 );
+	root.push_back( "added" ).push_back( "yes" );
+	ASSERT_EQ(
+		"version 2\n"
+		"name\t\t'my app'\n"
+		"\n"
+		"window:\n"
+		"\ttitle   \"main window\"\n"
+		"\n"
+		"\tvisible false\n"
+		"\twidth 640\n"
+		"notes::\n"
+		"\tsome text\n"
+		"end 1\n"
+		"added yes",
+		emitPreserving( root, source )
+	);
+
+	// not parsed from this source: emitted normally
+	ASSERT_EQ( emit( root ), emitPreserving( root, "" ) );
+
+	// without span tracking, everything is emitted anew
+	Node untracked = parse( source );
+	ASSERT_FALSE( untracked.span.isValid() );
+	ASSERT_EQ( emit( untracked ), emitPreserving( untracked, source ) );
+}
+
+TEST( Emitter, emitPreserving_newlines ) {
+	const std::string source =
+		"name\t\t'my app'\r\n"
+		"window:\r\n"
+		"\ttitle   \"main window\"\r\n"
+		"\r\n"
+		"\tvisible true\r\n";
+
+	ParseOptions options;
+	options.trackSourceSpans = true;
+	Node root = parse( source, "", options );
+	ASSERT_EQ( source, emitPreserving( root, source ) );
+
+	// re-emitted lines use the newlines of the source
+	root[ "window" ][ "visible" ].setValue( "false" );
+	root[ "window" ].push_back( "text" ).push_back( "line 1\nline 2\nline 3" );
+	root.push_back( "added" ).push_back( "yes" );
+	ASSERT_EQ(
+		"name\t\t'my app'\r\n"
+		"window:\r\n"
+		"\ttitle   \"main window\"\r\n"
+		"\r\n"
+		"\tvisible false\r\n"
+		"\ttext::\r\n"
+		"\t\tline 1\r\n"
+		"\t\tline 2\r\n"
+		"\t\tline 3\r\n"
+		"added yes\r\n",
+		emitPreserving( root, source )
+	);
+
+	// the source doesn't end with a newline, so the output doesn't either
+	const std::string unterminated = "a 1\r\nb 2";
+	Node last = parse( unterminated, "", options );
+	last[ "b" ].setValue( 3 );
+	ASSERT_EQ( "a 1\r\nb 3", emitPreserving( last, unterminated ) );
+}
+
+TEST( Emitter, emitPreserving_directChanges ) {
+	const std::string source =
+		"name\t\t'my app'\n"
+		"size\t\t10 20\n"
+		"window:\n"
+		"\ttitle   \"main window\"\n"
+		"\tvisible true";
+
+	ParseOptions options;
+	options.trackSourceSpans = true;
+	Node root = parse( source, "", options );
+
+	// reading through non-const accessors doesn't change the output
+	ASSERT_EQ( "my app", root[ "name" ].value() );
+	ASSERT_EQ( "window", root.nodes[ 2 ].key() );
+	for( auto &key : root[ "window" ].keys() ) {
+		ASSERT_FALSE( key.empty() );
+	}
+	ASSERT_EQ( source, emitPreserving( root, source ) );
+
+	// changes through the views and content are noticed
+	for( auto &value : root[ "size" ].values() ) {
+		value += "0";
+	}
+	*++root[ "window" ].keys().begin() = "shown";
+	root[ "name" ].nodes[ 0 ].content = "other";
+	ASSERT_EQ(
+		"name other\n"
+		"size 100 200\n"
+		"window:\n"
+		"\ttitle   \"main window\"\n"
+		"\tshown true",
+		emitPreserving( root, source )
+	);
+}
@@ -0,0 +1,442 @@
+/*
+Copyright 2013 Andreas Kirsch
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+// command line tool for WML files
+//
+// usage: wmltool [-j threads] <command> [options] [files...]
+//
+//	fmt [-i]				re-emits the files (in place with -i)
+//	validate [-s schema]	checks the syntax (and the schema)
+//	query <path>			prints the entries that match the path (see wml_path.h)
+//	stats					prints the statistics of parsing the files (see Stats)
+//	to-json					converts WML to JSON
+//	from-json				converts JSON to WML
+//
+// without files, stdin is read and the result is written to stdout
+// files are processed in parallel (-j, default: all cores) and the results are printed in order
+#include "wml.h"
+#include "wml_json.h"
+#include "wml_schema.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+
+#ifdef _WIN32
+#	define NOMINMAX
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+namespace {
+	// read-only view of a whole file (memory-mapped if possible)
+	struct InputFile {
+		const char *data;
+		size_t size;
+		// fallback for stdin and empty files
+		std::string buffer;
+
+#ifdef _WIN32
+		HANDLE file, mapping;
+#else
+		int file;
+#endif
+
+		bool map( const std::string &filename ) {
+#ifdef _WIN32
+			file = CreateFileA( filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+			if( file == INVALID_HANDLE_VALUE ) {
+				return false;
+			}
+			LARGE_INTEGER fileSize;
+			if( !GetFileSizeEx( file, &fileSize ) ) {
+				return false;
+			}
+			size = size_t( fileSize.QuadPart );
+			if( size == 0 ) {
+				return true;
+			}
+			mapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+			if( !mapping ) {
+				return false;
+			}
+			data = static_cast< const char * >( MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 ) );
+			return data != nullptr;
+#else
+			file = ::open( filename.c_str(), O_RDONLY );
+			if( file < 0 ) {
+				return false;
+			}
+			struct stat status;
+			if( ::fstat( file, &status ) != 0 ) {
+				return false;
+			}
+			size = size_t( status.st_size );
+			if( size == 0 ) {
+				return true;
+			}
+			void *mapped = ::mmap( nullptr, size, PROT_READ, MAP_PRIVATE, file, 0 );
+			if( mapped == MAP_FAILED ) {
+				return false;
+			}
+			::madvise( mapped, size, MADV_SEQUENTIAL );
+			data = static_cast< const char * >( mapped );
+			return true;
+#endif
+		}
+
+		void readStdin() {
+			buffer = std::string( std::istreambuf_iterator<char>( std::cin ), std::istreambuf_iterator<char>() );
+			data = buffer.data();
+			size = buffer.size();
+		}
+
+		// the parser reads the mapping in place
+		std::string_view text() const {
+			return std::string_view( data ? data : "", size );
+		}
+
+		InputFile() : data( nullptr ), size( 0 ) {
+#ifdef _WIN32
+			file = INVALID_HANDLE_VALUE;
+			mapping = nullptr;
+#else
+			file = -1;
+#endif
+		}
+
+		~InputFile() {
+#ifdef _WIN32
+			if( data && buffer.empty() ) {
+				UnmapViewOfFile( data );
+			}
+			if( mapping ) {
+				CloseHandle( mapping );
+			}
+			if( file != INVALID_HANDLE_VALUE ) {
+				CloseHandle( file );
+			}
+#else
+			if( data && buffer.empty() ) {
+				::munmap( const_cast< char * >( data ), size );
+			}
+			if( file >= 0 ) {
+				::close( file );
+			}
+#endif
+		}
+
+		InputFile( const InputFile & ) = delete;
+		InputFile & operator = ( const InputFile & ) = delete;
+	};
+
+	// writes to a new temporary file next to the original first and renames it over the original,
+	// so a failed write doesn't destroy it (the temporary name is unique, so concurrent runs don't collide)
+	bool replaceFile( const std::string &filename, const wml::Node &root ) {
+#ifdef _WIN32
+		const size_t separator = filename.find_last_of( "/\\" );
+		const std::string directory = separator == std::string::npos ? "." : filename.substr( 0, separator );
+		char temporaryName[ MAX_PATH ];
+		if( !GetTempFileNameA( directory.c_str(), "wml", 0, temporaryName ) ) {
+			return false;
+		}
+		const std::string temporary = temporaryName;
+
+		bool success;
+		{
+			std::ofstream file( temporary, std::ios_base::binary | std::ios_base::trunc );
+			wml::emit( root, file );
+			file.close();
+			success = bool( file );
+		}
+		success = success && MoveFileExA( temporary.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING ) != 0;
+#else
+		std::string temporary = filename + ".XXXXXX";
+		const int file = ::mkstemp( &temporary[0] );
+		if( file < 0 ) {
+			return false;
+		}
+
+		// mkstemp creates the file for the owner only
+		struct stat status;
+		bool success = ::stat( filename.c_str(), &status ) != 0 || ::fchmod( file, status.st_mode & 07777 ) == 0;
+		success = success && wml::emitToDescriptor( root, file );
+		success = ::close( file ) == 0 && success;
+		success = success && std::rename( temporary.c_str(), filename.c_str() ) == 0;
+#endif
+		if( !success ) {
+			std::remove( temporary.c_str() );
+		}
+		return success;
+	}
+
+	// istream over memory (for the JSON reader)
+	struct MemoryBuffer : std::streambuf {
+		MemoryBuffer( const char *data, size_t size ) {
+			char *begin = const_cast< char * >( data );
+			setg( begin, begin, begin + size );
+		}
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+	// commands
+
+	struct Options {
+		std::string command;
+		unsigned numThreads;
+		bool inPlace;
+		std::string schemaFile;
+		std::string path;
+		std::vector< std::string > files;
+
+		Options() : numThreads( std::max( 1u, std::thread::hardware_concurrency() ) ), inPlace( false ) {}
+	};
+
+	struct Tool {
+		const Options &options;
+		std::unique_ptr< wml::Schema > schema;
+		std::unique_ptr< wml::Path > path;
+
+		// processes one file (or stdin if filename is empty) and writes its result to output
+		// returns false (after writing an error message to errors) if the file failed
+		bool process( const std::string &filename, std::ostream &output, std::ostream &errors ) {
+			InputFile input;
+			if( filename.empty() ) {
+				input.readStdin();
+			}
+			else if( !input.map( filename ) ) {
+				errors << filename << ": cannot open file!\n";
+				return false;
+			}
+			const std::string_view text = input.text();
+
+			try {
+				const std::string &command = options.command;
+
+				if( command == "from-json" ) {
+					MemoryBuffer buffer( text.data(), text.size() );
+					std::istream stream( &buffer );
+					wml::jsonToWml( stream, output, filename );
+					return true;
+				}
+
+				if( command == "to-json" ) {
+					wml::wmlToJson( text, output, filename );
+					return true;
+				}
+
+				if( command == "validate" && schema ) {
+					const std::vector< wml::Violation > violations = schema->validateText( text, filename );
+					for( auto violation = violations.cbegin() ; violation != violations.cend() ; ++violation ) {
+						errors << violation->describe() << "\n";
+					}
+					return violations.empty();
+				}
+
+				wml::Stats stats;
+				const wml::Node root = wml::parse( text, filename, wml::ParseOptions(), &stats );
+
+				if( command == "fmt" && options.inPlace ) {
+					if( !replaceFile( filename, root ) ) {
+						errors << filename << ": cannot write file!\n";
+						return false;
+					}
+				}
+				else if( command == "fmt" ) {
+					wml::emit( root, output );
+				}
+				else if( command == "query" ) {
+					wml::detail::StringOutput text;
+					wml::detail::Emitter< wml::detail::StringOutput > emitter( text );
+					for( auto match : path->select( root ) ) {
+						emitter.emitEntry( match );
+					}
+					output << text.text;
+				}
+				else if( command == "stats" ) {
+					output << ( filename.empty() ? "<stdin>" : filename ) << ": " << stats.bytes << " bytes, " << stats.nodes << " nodes, depth " << stats.maxDepth
+						<< ", fan-out " << stats.maxFanOut << ", " << stats.escapedStrings << " escaped strings, " << stats.textBlocks << " text blocks, "
+						<< stats.parseTime * 1e3 << " ms\n";
+				}
+			}
+			catch( std::exception &e ) {
+				errors << e.what() << "\n";
+				return false;
+			}
+			return true;
+		}
+
+		// processes the files on options.numThreads threads and prints the results in order
+		bool run() {
+			if( options.files.empty() ) {
+				return process( "", std::cout, std::cerr );
+			}
+
+			struct Result {
+				std::ostringstream output, errors;
+				bool success;
+				bool isDone;
+
+				Result() : success( false ), isDone( false ) {}
+			};
+			std::vector< Result > results( options.files.size() );
+
+			std::mutex mutex;
+			std::condition_variable resultDone;
+			std::atomic< size_t > nextFile( 0 );
+
+			auto work = [&] () {
+				for( size_t i = nextFile++ ; i < options.files.size() ; i = nextFile++ ) {
+					const bool success = process( options.files[ i ], results[ i ].output, results[ i ].errors );
+
+					std::lock_guard< std::mutex > lock( mutex );
+					results[ i ].success = success;
+					results[ i ].isDone = true;
+					resultDone.notify_all();
+				}
+			};
+
+			std::vector< std::thread > threads;
+			try {
+				for( unsigned i = 0 ; i < std::min< size_t >( options.numThreads, options.files.size() ) ; ++i ) {
+					threads.push_back( std::thread( work ) );
+				}
+			}
+			catch( const std::system_error & ) {
+				// use the threads that could be started
+			}
+			if( threads.empty() ) {
+				work();
+			}
+
+			bool success = true;
+			for( size_t i = 0 ; i < results.size() ; ++i ) {
+				{
+					std::unique_lock< std::mutex > lock( mutex );
+					resultDone.wait( lock, [&] () { return results[ i ].isDone; } );
+				}
+				std::cout << results[ i ].output.str();
+				std::cerr << results[ i ].errors.str();
+				success = success && results[ i ].success;
+
+				// free the memory early
+				results[ i ].output.str( std::string() );
+			}
+
+			for( auto thread = threads.begin() ; thread != threads.end() ; ++thread ) {
+				thread->join();
+			}
+			return success;
+		}
+
+		explicit Tool( const Options &options ) : options( options ) {
+			if( !options.schemaFile.empty() ) {
+				// parseFile returns an empty tree for missing files, which would report every key as unknown
+				std::ifstream schemaFile( options.schemaFile, std::ios_base::binary );
+				if( !schemaFile.is_open() ) {
+					throw std::runtime_error( options.schemaFile + ": cannot open schema file!" );
+				}
+				schema.reset( new wml::Schema( wml::parse( schemaFile, options.schemaFile ) ) );
+			}
+			if( options.command == "query" ) {
+				path.reset( new wml::Path( options.path ) );
+			}
+		}
+	};
+
+	bool parseOptions( int argc, char **argv, Options &options ) {
+		int i = 1;
+		if( i + 1 < argc && std::string( argv[ i ] ) == "-j" ) {
+			options.numThreads = std::max( 1, atoi( argv[ i + 1 ] ) );
+			i += 2;
+		}
+		if( i == argc ) {
+			return false;
+		}
+
+		options.command = argv[ i++ ];
+		const std::string &command = options.command;
+		if( command == "fmt" && i < argc && std::string( argv[ i ] ) == "-i" ) {
+			options.inPlace = true;
+			++i;
+		}
+		else if( command == "validate" && i + 1 < argc && std::string( argv[ i ] ) == "-s" ) {
+			options.schemaFile = argv[ i + 1 ];
+			i += 2;
+		}
+		else if( command == "query" ) {
+			if( i == argc ) {
+				return false;
+			}
+			options.path = argv[ i++ ];
+		}
+		else if( command != "fmt" && command != "validate" && command != "stats" && command != "to-json" && command != "from-json" ) {
+			return false;
+		}
+
+		options.files.assign( argv + i, argv + argc );
+		return !( options.inPlace && options.files.empty() );
+	}
+}
+
+int main( int argc, char **argv ) {
+	Options options;
+	if( !parseOptions( argc, argv, options ) ) {
+		std::cerr <<
+			"usage: wmltool [-j threads] <command> [files...]\n"
+			"\n"
+			"commands:\n"
+			"\tfmt [-i]              re-emit (in place with -i)\n"
+			"\tvalidate [-s schema]  check the syntax (and the schema)\n"
+			"\tquery <path>          print the matching entries\n"
+			"\tstats                 print parse statistics\n"
+			"\tto-json               convert WML to JSON\n"
+			"\tfrom-json             convert JSON to WML\n"
+			"\n"
+			"without files, stdin is read\n";
+		return 2;
+	}
+
+	std::ios_base::sync_with_stdio( false );
+
+	try {
+		Tool tool( options );
+		return tool.run() ? 0 : 1;
+	}
+	catch( std::exception &e ) {
+		std::cerr << e.what() << std::endl;
+		return 2;
+	}
+}
@@ -0,0 +1,88 @@
+/*
+Copyright 2013 Andreas Kirsch
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include "gtest.h"
+
+#include "wml_writer.h"
+
+#include <sstream>
+
+using namespace wml;
+
+TEST( Writer, sameAsEmit ) {
+	std::string text;
+	{
+		Writer writer( [&text] ( const char *data, size_t size ) { text.append( data, size ); }, 16 );
+		writer.beginMap( "server" );
+		writer.entry( "host", "local host" );
+		writer.entry( "ports", 80, 8080 );
+		writer.entry( "ratio", 0.5 );
+		writer.entry( "enabled", true );
+		writer.textBlock( "motd", "hello\n\tworld\n!" );
+		writer.beginMap( "users" );
+		writer.entryValues( "names", std::vector< std::string >{ "a", "b c", "d\te" } );
+		writer.entry( "quote", std::string( "it's" ) );
+		writer.endMap();
+		writer.endMap();
+		writer.entry( "empty" );
+		writer.beginMap( "emptyMap" );
+		writer.endMap();
+		writer.finish();
+	}
+
+	Node root;
+	Node &server = root.push_back( "server" );
+	server.push_back( "host" ).push_back( "local host" );
+	server.push_back( "ports" ).push_back( 80 );
+	server[ "ports" ].push_back( 8080 );
+	server.push_back( "ratio" ).push_back( 0.5 );
+	server.push_back( "enabled" ).push_back( true );
+	server.push_back( "motd" ).push_back( "hello\n\tworld\n!" );
+	Node &users = server.push_back( "users" );
+	Node &names = users.push_back( "names" );
+	names.push_back( "a" );
+	names.push_back( "b c" );
+	names.push_back( "d\te" );
+	users.push_back( "quote" ).push_back( "it's" );
+	root.push_back( "empty" );
+	root.push_back( "emptyMap" );
+
+	ASSERT_EQ( emit( root ), text );
+	ASSERT_EQ( text, emit( parse( text ) ) );
+}
+
+TEST( Writer, textBlocks ) {
+	std::ostringstream stream;
+	Writer writer( stream );
+	writer.textBlock( "short", "one line" );
+	writer.textBlock( "control", "a\r\nb" );
+	writer.entry( "multiline", "x\ny\nz" );
+	writer.entry( "inline", "x\ny\nz", 1 );
+	writer.finish();
+
+	Node root = parse( stream.str() );
+	ASSERT_EQ( "one line", root[ "short" ].value() );
+	ASSERT_EQ( "a\r\nb", root[ "control" ].value() );
+	ASSERT_EQ( "x\ny\nz", root[ "multiline" ].value() );
+	ASSERT_EQ( "x\ny\nz", root[ "inline" ][0].key() );
+	ASSERT_EQ( 2, root[ "inline" ].size() );
+}